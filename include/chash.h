@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _CHASH_H
+#define _CHASH_H
+
+#include <sched.h>
+#include <rculist.h>
+#include <hash.h>
+#include <ebr.h>
+
+/*
+ * Concurrent hash table of hlist_head buckets with lock-free lookups.
+ *
+ * Readers take no lock and write nothing shared: they walk a chain with
+ * hlist_for_each_entry_rcu() inside an ebr_read_lock() section. Writers
+ * serialize per bucket on a striped spinlock, bucket i using lock
+ * i & lock_mask, so writers to different buckets mostly do not contend
+ * either. Inserts publish a fully initialized entry, deletes unlink it
+ * while leaving it walkable, and an entry is replaced as a whole with
+ * chash_replace(), so a reader always sees a consistent entry: the fields
+ * of a published entry must not change. An unlinked entry is freed with
+ * ebr_call(), once no reader can hold it any more.
+ *
+ * Like rhash, every entry embeds a struct chash_node that keeps the hash
+ * of its key, and the bucket comes from the top bits of the hash. The
+ * bucket count is fixed at chash_init(): resizing would need readers to
+ * follow two arrays under concurrent migration, so size the table for the
+ * expected number of entries.
+ *
+ * Insert-if-absent is chash_lock(), chash_find(), __chash_add() and
+ * chash_unlock(): lookups under the bucket lock see every entry. The
+ * __chash_*() writers expect the bucket lock to be held.
+ */
+
+#define CHASH_LOCKS_PER_CPU	4	/* default lock stripes per online CPU */
+
+struct chash_node {
+	struct hlist_node node;
+	uint64_t hash;
+};
+
+struct chash_lock {
+	int locked;
+	size_t nelems;		/* entries of this stripe, read unlocked */
+} ____cacheline_aligned;
+
+struct chash {
+	struct hlist_head *buckets;
+	unsigned int bits;
+	struct chash_lock *locks;
+	size_t lock_mask;
+};
+
+/**
+ * chash_init - initialize an empty table
+ * @t: table to initialize
+ * @bits: log2 of the bucket count, at most 8 * sizeof(size_t) - 1
+ * @nb_locks: number of lock stripes, rounded up to a power of two and
+ *            capped at the bucket count; 0 for CHASH_LOCKS_PER_CPU per
+ *            online CPU
+ *
+ * Return: 0, -EINVAL or -ENOMEM
+ */
+int chash_init(struct chash *t, unsigned int bits, size_t nb_locks);
+
+/**
+ * chash_destroy - free the buckets and locks of a table, not the entries
+ * @t: table no other thread uses any more
+ */
+void chash_destroy(struct chash *t);
+
+/**
+ * chash_count - number of entries
+ * @t: table to count
+ *
+ * Exact only while no writer runs.
+ */
+size_t chash_count(const struct chash *t);
+
+static inline struct hlist_head *chash_bucket(const struct chash *t,
+					      uint64_t hash)
+{
+	return &t->buckets[hash >> (64 - t->bits)];
+}
+
+static inline struct chash_lock *chash_lock_of(const struct chash *t,
+					       uint64_t hash)
+{
+	return &t->locks[(hash >> (64 - t->bits)) & t->lock_mask];
+}
+
+/**
+ * chash_lock - lock the bucket of a hash against other writers
+ * @t: table to lock
+ * @hash: hash of the key to work on
+ *
+ * Writers hold it for a few stores, so it spins; it yields to the holder
+ * only after a while, for oversubscribed CPUs.
+ */
+static inline void chash_lock(struct chash *t, uint64_t hash)
+{
+	struct chash_lock *l = chash_lock_of(t, hash);
+	int spin = 0;
+
+	while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&l->locked, __ATOMIC_RELAXED)) {
+			if (++spin < 128)
+				cpu_relax();
+			else
+				sched_yield();
+		}
+	}
+}
+
+static inline void chash_unlock(struct chash *t, uint64_t hash)
+{
+	smp_store_release(&chash_lock_of(t, hash)->locked, 0);
+}
+
+/* Insert with the bucket of hash locked. */
+static inline void __chash_add(struct chash *t, struct chash_node *n,
+			       uint64_t hash)
+{
+	struct chash_lock *l = chash_lock_of(t, hash);
+
+	n->hash = hash;
+	hlist_add_head_rcu(&n->node, chash_bucket(t, hash));
+	/* serialized by the lock, atomic only for chash_count() */
+	__atomic_store_n(&l->nelems, l->nelems + 1, __ATOMIC_RELAXED);
+}
+
+/* Remove with the bucket of n->hash locked. */
+static inline void __chash_del(struct chash *t, struct chash_node *n)
+{
+	struct chash_lock *l = chash_lock_of(t, n->hash);
+
+	hlist_del_rcu(&n->node);
+	__atomic_store_n(&l->nelems, l->nelems - 1, __ATOMIC_RELAXED);
+}
+
+/* Replace with the bucket of old->hash locked. */
+static inline void __chash_replace(struct chash_node *old,
+				   struct chash_node *new)
+{
+	new->hash = old->hash;
+	hlist_replace_rcu(&old->node, &new->node);
+}
+
+/**
+ * chash_add - insert an entry
+ * @t: table to insert into
+ * @n: the &struct chash_node of the entry, the rest of it initialized
+ * @hash: hash of the key of the entry
+ */
+static inline void chash_add(struct chash *t, struct chash_node *n,
+			     uint64_t hash)
+{
+	chash_lock(t, hash);
+	__chash_add(t, n, hash);
+	chash_unlock(t, hash);
+}
+
+/**
+ * chash_del - remove an entry
+ * @t: table the entry is in
+ * @n: the &struct chash_node of the entry
+ *
+ * Readers may still be on the entry: free it with ebr_call().
+ */
+static inline void chash_del(struct chash *t, struct chash_node *n)
+{
+	uint64_t hash = n->hash;
+
+	chash_lock(t, hash);
+	__chash_del(t, n);
+	chash_unlock(t, hash);
+}
+
+/**
+ * chash_replace - atomically swap an entry for a new version of it
+ * @t: table the entry is in
+ * @old: the &struct chash_node of the entry
+ * @new: the &struct chash_node of the new version, with the same key
+ *
+ * Readers find either version. Free @old with ebr_call().
+ */
+static inline void chash_replace(struct chash *t, struct chash_node *old,
+				 struct chash_node *new)
+{
+	uint64_t hash = old->hash;
+
+	chash_lock(t, hash);
+	__chash_replace(old, new);
+	chash_unlock(t, hash);
+}
+
+/**
+ * chash_find - look up an entry
+ * @t: table to search
+ * @obj: the type * set to the entry found, or NULL
+ * @member: the name of the &struct chash_node within the struct
+ * @hash_: hash of the key to look for
+ * @cond: expression of obj true for the entry looked for, evaluated only
+ *        for entries with the same hash
+ *
+ * Lock-free: call it inside an ebr_read_lock() section, and use obj only
+ * until that section ends. It also works under chash_lock().
+ */
+#define chash_find(t, obj, member, hash_, cond)				\
+	do {								\
+		uint64_t __h = (hash_);					\
+									\
+		hlist_for_each_entry_rcu(obj, chash_bucket(t, __h),	\
+					 member.node) {			\
+			if ((obj)->member.hash == __h && (cond))	\
+				break;					\
+		}							\
+	} while (0)
+
+#endif /* _CHASH_H */
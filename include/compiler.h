@@ -17,6 +17,26 @@
 #define barrier()                       __asm__ __volatile__("": : :"memory")
 #define barrier_data(ptr)               __asm__ __volatile__("": :"r"(ptr) :"memory")
 
+#define smp_mb()                        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb()                       __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb()                       __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_load_acquire(p)             __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)         __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/*
+ * Publish an initialized object to lock-free readers, and read a pointer
+ * published that way: readers see the object as it was when published.
+ */
+#define rcu_assign_pointer(p, v)        __atomic_store_n(&(p), v, __ATOMIC_RELEASE)
+#define rcu_dereference(p)              __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define RCU_INIT_POINTER(p, v)          __atomic_store_n(&(p), v, __ATOMIC_RELAXED)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()                     __builtin_ia32_pause()
+#else
+#define cpu_relax()                     barrier()
+#endif
+
 #define __user		__attribute__((noderef, address_space(1)))
 #define __kernel	__attribute__((address_space(0)))
 #define __safe		__attribute__((safe))
@@ -37,6 +57,11 @@
 #define __aligned(x)                    __attribute__((__aligned__(x)))
 #define __aligned_largest               __attribute__((__aligned__))
 
+#ifndef L1_CACHE_BYTES
+#define L1_CACHE_BYTES                  64
+#endif
+#define ____cacheline_aligned           __aligned(L1_CACHE_BYTES)
+
 #ifndef __always_inline
 #define __always_inline                 inline __attribute__((__always_inline__))
 #endif
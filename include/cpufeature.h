@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _CPUFEATURE_H
+#define _CPUFEATURE_H
+
+#include <compiler.h>
+
+/*
+ * Runtime selection of optimized kernels.
+ *
+ * The library is built for the baseline ISA, and the routines that have
+ * faster versions for wider vector units compile them with target
+ * attributes next to the generic one. Which one runs is decided once per
+ * process from the CPU level below, so one binary runs everywhere and uses
+ * what the machine has.
+ *
+ * The levels follow the x86-64 psABI microarchitecture levels. A level
+ * includes all lower ones, and counts only if the OS saves the matching
+ * register state (XCR0), not just if CPUID lists it.
+ *
+ * The environment variable CORE_BASE_CPU_LEVEL caps the level, to compare
+ * kernels on one machine or to rule one out: "generic", "sse2", "sse4.2",
+ * "avx2", "avx512", or "x86-64-v1" to "x86-64-v4". A level above the
+ * detected one is ignored.
+ */
+
+enum cpu_level {
+	CPU_LEVEL_GENERIC,	/* no vector unit assumed */
+	CPU_LEVEL_SSE2,		/* x86-64-v1: SSE, SSE2 */
+	CPU_LEVEL_SSE42,	/* x86-64-v2: + SSSE3, SSE4.1, SSE4.2, POPCNT */
+	CPU_LEVEL_AVX2,		/* x86-64-v3: + AVX, AVX2, BMI1, BMI2, FMA */
+	CPU_LEVEL_AVX512,	/* x86-64-v4: + AVX512F, BW, CD, DQ, VL */
+	CPU_LEVEL_MAX = CPU_LEVEL_AVX512,
+};
+
+#define CPU_LEVEL_ENV	"CORE_BASE_CPU_LEVEL"
+
+/**
+ * cpu_level() - level of the kernels to run.
+ *
+ * Detected, and capped by CORE_BASE_CPU_LEVEL, at load time or on the first
+ * call, whichever comes first; constant afterwards.
+ *
+ * Return: an enum cpu_level
+ */
+int cpu_level(void);
+
+/**
+ * cpu_level_detected() - level of the CPU, ignoring CORE_BASE_CPU_LEVEL.
+ */
+int cpu_level_detected(void);
+
+/**
+ * cpu_level_name() - name of a level, as accepted in CORE_BASE_CPU_LEVEL.
+ */
+const char *cpu_level_name(int level);
+
+#endif /* _CPUFEATURE_H */
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _EBR_H
+#define _EBR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <compiler.h>
+#include <list.h>
+
+/*
+ * Epoch based reclamation: tells a writer when an object it unlinked from
+ * a structure walked by lock-free readers can no longer be reached.
+ *
+ * Each reader thread registers a struct ebr_thread. Entering a read-side
+ * critical section copies the global epoch into it, leaving stores 0. A
+ * grace period advances the global epoch, then waits for every thread that
+ * is inside a section entered under an older epoch: those are the only
+ * ones that can still hold a pointer to something unlinked before. The
+ * read side is a store and a full barrier on the thread's own cache line,
+ * with no shared write, so readers do not slow each other down. The
+ * barrier still costs about as much as an uncontended mutex, so a thread
+ * doing many lookups in a row should cover them with one section.
+ *
+ * Writers defer the freeing of an unlinked object with ebr_call(); the
+ * callbacks are run in batches of @batch after one grace period, which
+ * amortizes its cost. ebr_synchronize() and ebr_barrier() wait for the
+ * readers, so they must not be called from inside a read-side section,
+ * and ebr_call() may call ebr_barrier().
+ */
+
+struct ebr_thread {
+	struct list_head list;	/* first, ebr_synchronize() casts to it */
+	uint64_t epoch;		/* epoch of the section entered, 0 outside */
+	unsigned int nesting;
+} ____cacheline_aligned;
+
+struct ebr_head {
+	struct ebr_head *next;
+	void (*func)(struct ebr_head *head);
+};
+
+struct ebr {
+	uint64_t epoch ____cacheline_aligned;
+	pthread_mutex_t lock;	/* threads, and one grace period at a time */
+	struct list_head threads;
+	struct ebr_head *pending ____cacheline_aligned;	/* lock-free stack */
+	size_t nb_pending;
+	size_t batch;
+};
+
+#define EBR_BATCH	256	/* default callbacks per grace period */
+
+/**
+ * ebr_init - initialize a reclamation domain
+ * @d: domain to initialize
+ * @batch: number of deferred callbacks that triggers a grace period,
+ *         0 for EBR_BATCH
+ *
+ * Return: 0, or a negative errno
+ */
+int ebr_init(struct ebr *d, size_t batch);
+
+/**
+ * ebr_destroy - run the pending callbacks and free a domain
+ * @d: domain with no registered thread left
+ */
+void ebr_destroy(struct ebr *d);
+
+/**
+ * ebr_thread_register - make a thread a reader of a domain
+ * @d: domain to read
+ * @t: per-thread state, owned by the calling thread
+ */
+void ebr_thread_register(struct ebr *d, struct ebr_thread *t);
+
+/**
+ * ebr_thread_unregister - stop reading a domain
+ * @d: domain read
+ * @t: state registered by the calling thread, outside any section
+ */
+void ebr_thread_unregister(struct ebr *d, struct ebr_thread *t);
+
+/**
+ * ebr_synchronize - wait for a grace period
+ * @d: domain to wait on
+ *
+ * Returns once every read-side section that was running when it was
+ * called has ended. Sections entered since are not waited for.
+ */
+void ebr_synchronize(struct ebr *d);
+
+/**
+ * ebr_call - free an object once readers cannot reach it any more
+ * @d: domain the object was reachable from
+ * @head: the &struct ebr_head embedded in the unlinked object
+ * @func: called with @head after a grace period
+ *
+ * May run a grace period and the pending callbacks, from this thread.
+ */
+void ebr_call(struct ebr *d, struct ebr_head *head,
+	      void (*func)(struct ebr_head *head));
+
+/**
+ * ebr_barrier - run all the callbacks queued so far
+ * @d: domain to flush
+ */
+void ebr_barrier(struct ebr *d);
+
+/**
+ * ebr_read_lock - enter a read-side critical section
+ * @d: domain to read
+ * @t: state registered by the calling thread
+ *
+ * Sections nest; only the outermost one takes the epoch.
+ */
+static inline void ebr_read_lock(struct ebr *d, struct ebr_thread *t)
+{
+	if (t->nesting++)
+		return;
+	__atomic_store_n(&t->epoch, __atomic_load_n(&d->epoch, __ATOMIC_RELAXED),
+			 __ATOMIC_RELAXED);
+	/* the epoch must be visible before the first read of the structure */
+	smp_mb();
+}
+
+/**
+ * ebr_read_unlock - leave a read-side critical section
+ * @d: domain read
+ * @t: state registered by the calling thread
+ */
+static inline void ebr_read_unlock(struct ebr *d, struct ebr_thread *t)
+{
+	(void)d;
+	if (--t->nesting)
+		return;
+	smp_store_release(&t->epoch, 0);
+}
+
+#endif /* _EBR_H */
@@ -26,13 +26,101 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <compiler.h>
+
+/*
+ * A fifo_buffer may be shared by one producer thread and one consumer
+ * thread without a lock. fifo_generic_write() and fifo_write_reserve/commit()
+ * are the producer side, fifo_generic_read(), fifo_generic_peek*(),
+ * fifo_read_acquire/release() and fifo_drain() are the consumer side,
+ * fifo_size() and fifo_space() may be called from either.
+ * wndx is published with release semantics after the data is written and
+ * rndx after the data is consumed, so the other side never observes an
+ * index ahead of the bytes it covers.
+ * fifo_reset(), fifo_realloc2() and fifo_grow() still need exclusive access.
+ *
+ * The consumer and producer state live on separate cache lines so the two
+ * threads do not false-share the lines they write.
+ *
+ * The structure holds no pointers: the storage is found at a fixed offset
+ * from the fifo_buffer itself and the read and write positions are offsets
+ * into it, so the same fifo_buffer can be mapped at different addresses by
+ * a producer and a consumer process, see fifo_alloc_shared().
+ */
+
+/**
+ * The buffer is a memfd mapped twice back to back, see fifo_alloc_mirrored().
+ */
+#define FIFO_FLAG_MIRRORED  (1 << 0)
+
+/**
+ * The size is rounded up to a power of two and a position is found by
+ * masking its free-running index, see fifo_peek_pow2().
+ */
+#define FIFO_FLAG_POW2      (1 << 1)
+
+/**
+ * Enable fifo_read_wait() and fifo_write_wait(). Every index update then
+ * checks, after a full barrier, whether the other side sleeps on a
+ * threshold that has just been crossed, and only then issues a futex wake.
+ */
+#define FIFO_FLAG_BLOCKING  (1 << 2)
+
+/**
+ * The fifo_buffer and its storage live in a caller supplied fd, set by
+ * fifo_alloc_shared().
+ */
+#define FIFO_FLAG_SHARED    (1 << 3)
 
 typedef struct fifo_buffer {
-    uint8_t *buffer;
-    uint8_t *rptr, *wptr, *end;
-    uint32_t rndx, wndx;
+    uint32_t magic; /* set once a shared fifo_buffer is initialized */
+    int flags;      /* FIFO_FLAG_* */
+    int fd;         /* backing memfd of a mirrored buffer, -1 otherwise */
+    ssize_t data;   /* offset of the storage from the fifo_buffer */
+    size_t size;    /* size of the storage */
+    size_t mask;    /* size - 1 of a FIFO_FLAG_POW2 buffer, 0 otherwise */
+
+    /* consumer side, written only by the reader */
+    size_t rpos ____cacheline_aligned;
+    uint64_t rndx;
+    size_t read_want;       /* data a sleeping reader waits for, 0 if none */
+    uint32_t read_seq;      /* data_seq value the reader sleeps on */
+    uint32_t space_seq;     /* futex word, bumped to wake the writer */
+    int read_spin;          /* adaptive spin budget of fifo_read_wait() */
+
+    /* producer side, written only by the writer */
+    size_t wpos ____cacheline_aligned;
+    uint64_t wndx;
+    size_t write_want;      /* space a sleeping writer waits for, 0 if none */
+    uint32_t write_seq;     /* space_seq value the writer sleeps on */
+    uint32_t data_seq;      /* futex word, bumped to wake the reader */
+    int write_spin;         /* adaptive spin budget of fifo_write_wait() */
 } fifo_buffer;
 
+/**
+ * Return the start of the storage of an fifo_buffer in this address space.
+ */
+static inline uint8_t *fifo_data(const fifo_buffer *f)
+{
+    return (uint8_t *)f + f->data;
+}
+
+/**
+ * Return the address of the next byte to read.
+ */
+static inline uint8_t *fifo_rptr(const fifo_buffer *f)
+{
+    return fifo_data(f) + f->rpos;
+}
+
+/**
+ * Return the address of the next byte to write.
+ */
+static inline uint8_t *fifo_wptr(const fifo_buffer *f)
+{
+    return fifo_data(f) + f->wpos;
+}
+
 /**
  * Initialize an fifo_buffer.
  * @param size of FIFO
@@ -48,6 +136,50 @@ fifo_buffer *fifo_alloc(unsigned int size);
  */
 fifo_buffer *fifo_alloc_array(size_t nmemb, size_t size);
 
+/**
+ * Initialize an fifo_buffer.
+ * @param size  size of FIFO
+ * @param flags a combination of FIFO_FLAG_*
+ * @return fifo_buffer or NULL in case of memory allocation failure
+ */
+fifo_buffer *fifo_alloc2(size_t size, int flags);
+
+/**
+ * Initialize an fifo_buffer whose storage is mapped twice back to back,
+ * so that any window of up to fifo size bytes starting at rptr or wptr is
+ * contiguous in memory. Reads, peeks and writes then never split at the
+ * wrap point, fifo_read_acquire() and fifo_write_reserve() always return a
+ * single span, and a parser or textsearch_find_continuous() can run
+ * directly over fifo_rptr() .. fifo_rptr() + fifo_size().
+ * @param size of FIFO, rounded up to a multiple of the page size
+ * @return fifo_buffer or NULL in case of allocation failure
+ */
+fifo_buffer *fifo_alloc_mirrored(size_t size);
+
+/**
+ * Initialize an fifo_buffer inside a file descriptor, typically a memfd or
+ * a shm_open() object, so a process that inherits or receives the fd can
+ * fifo_attach_shared() to it. The fd is resized to hold the fifo_buffer
+ * followed by the storage; the caller keeps ownership of it.
+ * One process may produce and one consume, with the same ordering
+ * guarantees as between two threads. FIFO_FLAG_BLOCKING works across
+ * processes. A shared FIFO cannot be resized.
+ * @param fd    file descriptor to lay the FIFO out in, opened read/write
+ * @param size  size of FIFO
+ * @param flags a combination of FIFO_FLAG_*
+ * @return fifo_buffer or NULL with errno set
+ */
+fifo_buffer *fifo_alloc_shared(int fd, size_t size, int flags);
+
+/**
+ * Map an fifo_buffer set up by fifo_alloc_shared() in another process.
+ * fifo_free() unmaps it again, the FIFO itself is left intact.
+ * @param fd file descriptor passed to fifo_alloc_shared()
+ * @return fifo_buffer or NULL with errno set, EINVAL if fd does not hold
+ *         an initialized FIFO
+ */
+fifo_buffer *fifo_attach_shared(int fd);
+
 /**
  * Free an fifo_buffer.
  * @param f fifo_buffer to free
@@ -70,7 +202,7 @@ void fifo_reset(fifo_buffer *f);
  * Return the amount of data in bytes in the fifo_buffer, that is the
  * amount of data you can read from it.
  * @param f fifo_buffer to read from
- * @return size
+ * @return size, clamped to INT_MAX; see fifo_size64()
  */
 int fifo_size(const fifo_buffer *f);
 
@@ -78,7 +210,7 @@ int fifo_size(const fifo_buffer *f);
  * Return the amount of space in bytes in the fifo_buffer, that is the
  * amount of data you can write into it.
  * @param f fifo_buffer to write into
- * @return size
+ * @return size, clamped to INT_MAX; see fifo_space64()
  */
 int fifo_space(const fifo_buffer *f);
 
@@ -127,9 +259,158 @@ int fifo_generic_read(fifo_buffer *f, void *dest, int buf_size, void (*func)(voi
  */
 int fifo_generic_write(fifo_buffer *f, void *src, int size, int (*func)(void*, void*, int));
 
+/**
+ * Get direct pointers to the free space of an fifo_buffer, so data can be
+ * produced in place instead of being copied in by fifo_generic_write().
+ * The space is returned as up to two spans, split at the wrap point;
+ * len[1] is 0 if the reserved space is contiguous.
+ * Nothing becomes visible to the reader until fifo_write_commit().
+ * @param f    fifo_buffer to write to
+ * @param want maximum number of bytes to reserve
+ * @param ptr  receives the start of each span
+ * @param len  receives the length of each span
+ * @return the number of bytes reserved, len[0] + len[1]
+ */
+int fifo_write_reserve(fifo_buffer *f, int want, uint8_t *ptr[2], int len[2]);
+
+/**
+ * Make data written in place after fifo_write_reserve() visible to the reader.
+ * @param f    fifo_buffer to write to
+ * @param size number of bytes to commit, at most what was reserved
+ */
+void fifo_write_commit(fifo_buffer *f, int size);
+
+/**
+ * Get direct pointers to the data of an fifo_buffer, so it can be parsed in
+ * place instead of being copied out by fifo_generic_read().
+ * The data is returned as up to two spans, split at the wrap point;
+ * len[1] is 0 if the acquired data is contiguous.
+ * The data stays in the FIFO until fifo_read_release().
+ * @param f    fifo_buffer to read from
+ * @param want maximum number of bytes to acquire
+ * @param ptr  receives the start of each span
+ * @param len  receives the length of each span
+ * @return the number of bytes acquired, len[0] + len[1]
+ */
+int fifo_read_acquire(fifo_buffer *f, int want, uint8_t *ptr[2], int len[2]);
+
+/**
+ * Discard data consumed in place after fifo_read_acquire(), handing the space
+ * back to the writer. Equivalent to fifo_drain().
+ * @param f    fifo_buffer to read from
+ * @param size number of bytes to release, at most what was acquired
+ */
+void fifo_read_release(fifo_buffer *f, int size);
+
+/**
+ * Read from a file descriptor directly into the free space of an fifo_buffer,
+ * with a single readv() covering both sides of the wrap point.
+ * @param f   fifo_buffer to write to
+ * @param fd  file descriptor to read from
+ * @param max maximum number of bytes to read
+ * @return the number of bytes read, 0 at end of file or if max <= 0,
+ *         -ENOSPC if the FIFO is full, -EAGAIN if a non-blocking fd has
+ *         no data, or another negative errno
+ */
+int fifo_fill_from_fd(fifo_buffer *f, int fd, int max);
+
+/**
+ * Write data from an fifo_buffer directly to a file descriptor, with a single
+ * writev() covering both sides of the wrap point. Only the bytes actually
+ * written are discarded from the FIFO.
+ * @param f   fifo_buffer to read from
+ * @param fd  file descriptor to write to
+ * @param max maximum number of bytes to write
+ * @return the number of bytes written, 0 if the FIFO is empty, -EAGAIN if a
+ *         non-blocking fd cannot take data, or another negative errno
+ */
+int fifo_drain_to_fd(fifo_buffer *f, int fd, int max);
+
+/**
+ * Wait until an fifo_buffer holds at least min_bytes of data.
+ * The caller spins for a while first, with a budget that grows when
+ * spinning pays off and shrinks when it does not, then sleeps on a futex
+ * until the writer crosses the threshold. Requires FIFO_FLAG_BLOCKING.
+ * @param f         fifo_buffer to read from
+ * @param min_bytes amount of data to wait for
+ * @param timeout   in milliseconds, < 0 to wait forever, 0 to only spin
+ * @return 0 once the data is there, -ETIMEDOUT, or -EINVAL if min_bytes
+ *         exceeds the FIFO size or the FIFO is not blocking
+ */
+int fifo_read_wait(fifo_buffer *f, size_t min_bytes, int timeout);
+
+/**
+ * Wait until an fifo_buffer has at least min_space bytes of free space.
+ * Same strategy and requirements as fifo_read_wait(), woken by the reader.
+ * @param f         fifo_buffer to write to
+ * @param min_space amount of space to wait for
+ * @param timeout   in milliseconds, < 0 to wait forever, 0 to only spin
+ * @return 0 once the space is there, -ETIMEDOUT, or -EINVAL if min_space
+ *         exceeds the FIFO size or the FIFO is not blocking
+ */
+int fifo_write_wait(fifo_buffer *f, size_t min_space, int timeout);
+
+/*
+ * Message framing.
+ * Records are stored as a native-endian uint32_t length followed by the
+ * payload. A record is committed with a single index update, so the reader
+ * never sees a partial one.
+ */
+
+/**
+ * In-place view of one message, split in up to two spans at the wrap point;
+ * len[1] is 0 if the payload is contiguous.
+ */
+typedef struct fifo_msg {
+    uint8_t *ptr[2];
+    int len[2];
+} fifo_msg;
+
+/**
+ * Append one message to an fifo_buffer, all or nothing.
+ * @param f    fifo_buffer to write to
+ * @param msg  payload
+ * @param size payload size in bytes
+ * @return 0 on success, -ENOSPC if the message does not fit
+ */
+int fifo_msg_push(fifo_buffer *f, const void *msg, int size);
+
+/**
+ * Look at the next message without copying or removing it.
+ * @param f   fifo_buffer to read from
+ * @param msg receives the payload spans
+ * @return the payload size, or -EAGAIN if there is no message
+ */
+int fifo_msg_peek(fifo_buffer *f, fifo_msg *msg);
+
+/**
+ * Remove the next message, copying its payload out.
+ * @param f    fifo_buffer to read from
+ * @param dest payload destination, NULL to discard the message
+ * @param size size of dest
+ * @return the payload size, -EAGAIN if there is no message, or -ENOBUFS
+ *         if dest is too small, in which case the message is kept
+ */
+int fifo_msg_pop(fifo_buffer *f, void *dest, int size);
+
+/**
+ * Look at up to nb consecutive messages in place. Passing the returned byte
+ * count to fifo_read_release() then pops the whole batch with one index
+ * update instead of one per message.
+ * @param f     fifo_buffer to read from
+ * @param msgs  receives the payload spans of each message
+ * @param nb    maximum number of messages
+ * @param bytes receives the framed size of the messages
+ * @return the number of messages
+ */
+int fifo_msg_peek_batch(fifo_buffer *f, fifo_msg *msgs, int nb, int *bytes);
+
 /**
  * Resize an fifo_buffer.
  * In case of reallocation failure, the old FIFO is kept unchanged.
+ * The storage is grown in place where possible and only the smaller part
+ * of wrapped data is moved, so growing does not copy the whole FIFO.
+ * The buffer never shrinks.
  *
  * @param f fifo_buffer to resize
  * @param size new fifo_buffer size in bytes
@@ -155,6 +436,67 @@ int fifo_grow(fifo_buffer *f, unsigned int additional_space);
  */
 void fifo_drain(fifo_buffer *f, int size);
 
+/*
+ * 64-bit API.
+ * The int API above caps a single request and the reported size and space
+ * below 2 GB. The functions below take and return size_t, so one FIFO can
+ * hold and move several gigabytes per call. rndx/wndx are 64-bit for both
+ * APIs, which can be mixed on the same fifo_buffer.
+ */
+
+/**
+ * Initialize an fifo_buffer of any size.
+ * @param size of FIFO
+ * @return fifo_buffer or NULL in case of memory allocation failure
+ */
+fifo_buffer *fifo_alloc64(size_t size);
+
+/**
+ * Same as fifo_size() without the INT_MAX limit.
+ */
+size_t fifo_size64(const fifo_buffer *f);
+
+/**
+ * Same as fifo_space() without the INT_MAX limit.
+ */
+size_t fifo_space64(const fifo_buffer *f);
+
+/**
+ * Same as fifo_generic_peek_at() with size_t offsets and chunks.
+ */
+int fifo_generic_peek_at64(fifo_buffer *f, void *dest, size_t offset, size_t buf_size,
+                           void (*func)(void*, void*, size_t));
+
+/**
+ * Same as fifo_generic_read() with size_t sizes and chunks.
+ */
+int fifo_generic_read64(fifo_buffer *f, void *dest, size_t buf_size,
+                        void (*func)(void*, void*, size_t));
+
+/**
+ * Same as fifo_generic_write() with size_t sizes and chunks; func returns
+ * the number of bytes written to dest_buf, or <= 0 when no more data is
+ * available.
+ * @return the number of bytes written to the FIFO
+ */
+size_t fifo_generic_write64(fifo_buffer *f, void *src, size_t size,
+                            ssize_t (*func)(void*, void*, size_t));
+
+/**
+ * Same as fifo_realloc2() with a size_t size.
+ */
+int fifo_realloc64(fifo_buffer *f, size_t size);
+
+/**
+ * Same as fifo_grow() with a size_t size.
+ */
+int fifo_grow64(fifo_buffer *f, size_t additional_space);
+
+/**
+ * Same as fifo_drain() with a size_t size.
+ */
+void fifo_drain64(fifo_buffer *f, size_t size);
+
 /**
  * Return a pointer to the data stored in a FIFO buffer at a certain offset.
  * The FIFO buffer is not modified.
@@ -167,12 +509,30 @@ void fifo_drain(fifo_buffer *f, int size);
  */
 static inline uint8_t* fifo_peek2(const fifo_buffer *f, int offs)
 {
-    uint8_t *ptr = f->rptr + offs;
-    if (ptr >= f->end)
-        ptr = f->buffer + (ptr - f->end);
-    else if (ptr < f->buffer)
-        ptr = f->end - (f->buffer - ptr);
-    return ptr;
+    ssize_t pos;
+
+    if (f->mask)
+        return fifo_data(f) + ((f->rndx + offs) & f->mask);
+
+    pos = f->rpos + offs;
+    if (pos >= (ssize_t)f->size)
+        pos -= f->size;
+    else if (pos < 0)
+        pos += f->size;
+    return fifo_data(f) + pos;
+}
+
+/**
+ * Same as fifo_peek2() without any branch, for a buffer allocated with
+ * FIFO_FLAG_POW2. Indices are free-running counters modulo 2^64, so the
+ * slot is the masked sum of the read index and the offset.
+ *
+ * @param f    fifo_buffer to peek at, allocated with FIFO_FLAG_POW2
+ * @param offs an offset in bytes, same constraints as for fifo_peek2()
+ */
+static inline uint8_t* fifo_peek_pow2(const fifo_buffer *f, int offs)
+{
+    return fifo_data(f) + ((f->rndx + offs) & f->mask);
 }
 
 #endif /* _FIFO_H */
@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/**
+ * @file
+ * a broadcast ring: one writer, several readers with their own read cursor
+ */
+
+#ifndef _FIFO_BCAST_H
+#define _FIFO_BCAST_H
+
+#include <fifo.h>
+
+/*
+ * The data is written once into a power-of-two fifo_buffer, and every reader
+ * consumes it through its own free-running index, so fanning a stream out to
+ * N readers needs neither N copies nor N buffers.
+ *
+ * A reader is either blocking or lossy. Blocking readers limit the space of
+ * the writer, which never overwrites data one of them has not read yet.
+ * Lossy readers never hold the writer back: when the writer needs their
+ * unread data, they are skipped forward past it and the skipped bytes are
+ * accounted in fifo_bcast_lost().
+ *
+ * One writer thread and one thread per reader may use a fifo_bcast without a
+ * lock. fifo_bcast_set_lossy() must not race with the writer nor with reads
+ * of that reader.
+ */
+
+struct fifo_bcast_reader {
+    uint64_t rndx;      /* read index, published with release semantics */
+    uint64_t lost;      /* bytes skipped over by a lossy reader */
+    int lossy;
+} ____cacheline_aligned;
+
+typedef struct fifo_bcast {
+    fifo_buffer *fifo;  /* storage and write side; its rndx is the tail */
+    uint64_t tail;      /* oldest index still held, advanced before overwrite */
+    int nb_readers;
+    struct fifo_bcast_reader *readers;
+} fifo_bcast;
+
+/**
+ * Initialize a fifo_bcast.
+ * @param size       size of the ring, rounded up to a power of two
+ * @param nb_readers number of readers, all blocking and at index 0
+ * @param flags      extra FIFO_FLAG_* for the storage, e.g. FIFO_FLAG_MIRRORED
+ * @return fifo_bcast or NULL in case of memory allocation failure
+ */
+fifo_bcast *fifo_bcast_alloc(size_t size, int nb_readers, int flags);
+
+/**
+ * Free a fifo_bcast.
+ * @param b fifo_bcast to free
+ */
+void fifo_bcast_free(fifo_bcast *b);
+
+/**
+ * Make a reader lossy or blocking.
+ * @param b      fifo_bcast the reader belongs to
+ * @param reader reader number
+ * @param lossy  nonzero to never let this reader hold the writer back
+ *
+ * A reader made blocking again first skips the data it was overrun by,
+ * which is accounted in fifo_bcast_lost().
+ */
+void fifo_bcast_set_lossy(fifo_bcast *b, int reader, int lossy);
+
+/**
+ * Return the amount of space in bytes the writer can use, that is the space
+ * left behind the slowest blocking reader.
+ * @param b fifo_bcast to write into
+ */
+size_t fifo_bcast_space(const fifo_bcast *b);
+
+/**
+ * Write data for all readers.
+ * @param b    fifo_bcast to write into
+ * @param src  data to write
+ * @param size number of bytes to write
+ * @return the number of bytes written, at most fifo_bcast_space()
+ */
+size_t fifo_bcast_write(fifo_bcast *b, const void *src, size_t size);
+
+/**
+ * Return the amount of data in bytes the given reader can read.
+ * @param b      fifo_bcast to read from
+ * @param reader reader number
+ */
+size_t fifo_bcast_size(const fifo_bcast *b, int reader);
+
+/**
+ * Read data as the given reader. A lossy reader that was overrun first skips
+ * to the oldest data still held.
+ * @param b      fifo_bcast to read from
+ * @param reader reader number
+ * @param dest   data destination
+ * @param size   maximum number of bytes to read
+ * @return the number of bytes read
+ */
+size_t fifo_bcast_read(fifo_bcast *b, int reader, void *dest, size_t size);
+
+/**
+ * Return the number of bytes a lossy reader has been skipped over so far.
+ * @param b      fifo_bcast the reader belongs to
+ * @param reader reader number
+ */
+uint64_t fifo_bcast_lost(const fifo_bcast *b, int reader);
+
+#endif /* _FIFO_BCAST_H */
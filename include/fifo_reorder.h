@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/**
+ * @file
+ * sequence number reorder (jitter) buffer
+ */
+
+#ifndef _FIFO_REORDER_H
+#define _FIFO_REORDER_H
+
+#include <fifo.h>
+
+/*
+ * Packets carrying a sequence number are inserted in arrival order and
+ * released in sequence order. The slots are the storage of a FIFO_FLAG_POW2
+ * fifo_buffer, the slot of a packet is its sequence number & mask, so an
+ * insert is one store and releasing a run is a walk over consecutive slots.
+ *
+ * A missing packet holds back the ones behind it until the first of them
+ * has waited timeout time units; the gap is then skipped and counted lost.
+ * A packet for a slot that is already held is a duplicate, one older than
+ * the release point is late; both are rejected.
+ *
+ * Sequence numbers are 64-bit; 16-bit RTP numbers can be extended with
+ * fifo_reorder_extend16(). Not thread safe.
+ */
+
+struct fifo_reorder_slot {
+    uint64_t seq;
+    uint64_t ts;        /* arrival time */
+    void *pkt;          /* NULL if the slot is free */
+    uint64_t reserved;
+};
+
+typedef struct fifo_reorder {
+    fifo_buffer *ring;  /* storage of the slots */
+    size_t mask;        /* number of slots - 1 */
+    uint64_t timeout;
+    uint64_t next;      /* sequence number to release next */
+    uint64_t first;     /* lowest held sequence number, if count */
+    size_t count;       /* packets held */
+    int started;        /* next was set by the first packet */
+    uint64_t lost, duplicate, late;
+} fifo_reorder;
+
+/**
+ * Initialize a fifo_reorder.
+ * @param slots   window in sequence numbers, rounded up to a power of two
+ * @param timeout longest time a packet waits for the ones before it
+ * @return fifo_reorder or NULL in case of memory allocation failure
+ */
+fifo_reorder *fifo_reorder_alloc(size_t slots, uint64_t timeout);
+
+/**
+ * Free a fifo_reorder.
+ * @param r        fifo_reorder to free, may be NULL
+ * @param free_pkt called on every packet still held, may be NULL
+ */
+void fifo_reorder_free(fifo_reorder *r, void (*free_pkt)(void *));
+
+/**
+ * Insert a packet. The first packet inserted sets the release point.
+ * @param r   fifo_reorder to insert into
+ * @param seq sequence number of the packet
+ * @param now arrival time, in the unit of the timeout
+ * @param pkt the packet, non-NULL; owned by r on success
+ * @return 0 on success, -EEXIST for a duplicate, -EALREADY for a packet
+ *         behind the release point, -ENOSPC if seq is a whole window ahead
+ *         of the release point
+ */
+int fifo_reorder_insert(fifo_reorder *r, uint64_t seq, uint64_t now, void *pkt);
+
+/**
+ * Release the next packet in sequence order, skipping a gap that timed out.
+ * @param r   fifo_reorder to release from
+ * @param now current time, in the unit of the timeout
+ * @param seq receives the sequence number of the packet, may be NULL
+ * @return the packet, or NULL if the next one is missing and has not timed
+ *         out
+ */
+void *fifo_reorder_pop(fifo_reorder *r, uint64_t now, uint64_t *seq);
+
+/**
+ * Release the next held packet regardless of the timeout, e.g. to make room
+ * after -ENOSPC or to flush at the end of a stream.
+ */
+void *fifo_reorder_flush(fifo_reorder *r, uint64_t *seq);
+
+/**
+ * Number of packets held.
+ */
+size_t fifo_reorder_count(const fifo_reorder *r);
+
+/**
+ * Extend a 16-bit wrapping sequence number to 64 bits, choosing the value
+ * closest to the release point.
+ */
+static inline uint64_t fifo_reorder_extend16(const fifo_reorder *r, uint16_t seq)
+{
+    uint64_t ext = (r->next & ~(uint64_t)0xffff) | seq;
+
+    if (!r->started)
+        return seq;
+    if (ext + 0x8000 < r->next)
+        ext += 0x10000;
+    else if (ext > r->next + 0x8000 && ext >= 0x10000)
+        ext -= 0x10000;
+    return ext;
+}
+
+#endif /* _FIFO_REORDER_H */
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/**
+ * @file
+ * asynchronous fill and drain of a fifo_buffer with io_uring
+ */
+
+#ifndef _FIFO_URING_H
+#define _FIFO_URING_H
+
+#include <fifo.h>
+
+/*
+ * A fill engine keeps up to depth reads in flight, each into its own chunk
+ * of the free space of a fifo_buffer, and commits the chunks to the reader
+ * in file order as they complete. A drain engine does the same with writes
+ * of the buffered data, releasing it once written. The engine takes the
+ * place of the producer (fill) or the consumer (drain) of the fifo_buffer,
+ * so the other side keeps using it without a lock and never waits for I/O.
+ *
+ * Requests are issued at explicit file offsets, so they may complete in any
+ * order. A short transfer stops issuing until the requests behind it have
+ * completed, their results are dropped and the engine resumes right after
+ * the last byte transferred.
+ *
+ * The rings are set up with the raw io_uring syscalls, no library needed.
+ */
+
+typedef struct fifo_uring fifo_uring;
+
+/**
+ * Initialize an engine reading fd into the free space of f.
+ * @param f      fifo_buffer to fill; the engine is its only producer
+ * @param fd     file to read from
+ * @param offset file offset of the first byte, -1 to read from the current
+ *               position of a stream, which keeps one request in flight
+ * @param depth  maximum number of reads in flight
+ * @param chunk  maximum size of a read
+ * @return fifo_uring or NULL with errno set
+ */
+fifo_uring *fifo_uring_alloc_fill(fifo_buffer *f, int fd, int64_t offset,
+                                  unsigned int depth, size_t chunk);
+
+/**
+ * Initialize an engine writing the data of f to fd.
+ * @param f      fifo_buffer to drain; the engine is its only consumer
+ * @param fd     file to write to
+ * @param offset file offset of the first byte, -1 for the current position
+ *               of a stream, which keeps one request in flight
+ * @param depth  maximum number of writes in flight
+ * @param chunk  maximum size of a write
+ * @return fifo_uring or NULL with errno set
+ */
+fifo_uring *fifo_uring_alloc_drain(fifo_buffer *f, int fd, int64_t offset,
+                                   unsigned int depth, size_t chunk);
+
+/**
+ * Wait for the requests in flight to complete and free the engine.
+ * The fifo_buffer and the fd are left open.
+ * @param u fifo_uring to free, may be NULL
+ */
+void fifo_uring_free(fifo_uring *u);
+
+/**
+ * Issue requests for as much free space (fill) or data (drain) as the depth
+ * allows, then collect the completed ones and commit or release their bytes.
+ * @param u            fifo_uring to run
+ * @param min_complete number of completions to wait for, capped to the
+ *                     requests in flight; 0 never blocks
+ * @return the number of bytes committed to or released from the FIFO,
+ *         or a negative errno of the first failed request
+ */
+ssize_t fifo_uring_run(fifo_uring *u, unsigned int min_complete);
+
+/**
+ * Return the number of requests in flight.
+ */
+unsigned int fifo_uring_inflight(const fifo_uring *u);
+
+/**
+ * Return the maximum number of requests in flight.
+ */
+unsigned int fifo_uring_depth(const fifo_uring *u);
+
+/**
+ * Return nonzero once a fill engine has read the end of the file.
+ */
+int fifo_uring_eof(const fifo_uring *u);
+
+#endif /* _FIFO_URING_H */
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/**
+ * @file
+ * sliding window aggregates over a ring of timestamped samples
+ */
+
+#ifndef _FIFO_WINDOW_H
+#define _FIFO_WINDOW_H
+
+#include <fifo.h>
+
+/*
+ * The samples of the window are kept in a fifo_alloc_array() ring, and every
+ * statistic is updated as a sample enters or leaves it, so reading one never
+ * walks the window:
+ *
+ * - min and max come from the front of two monotone deques, which hold the
+ *   samples that can still become the minimum or maximum. Each sample is
+ *   pushed and popped at most once per deque, O(1) amortized.
+ * - sum and count are running totals.
+ * - quantiles come from a log-linear histogram with 16 buckets per power of
+ *   two, which is decremented on eviction. A quantile is exact to within
+ *   1/16 of its value, and is found by walking per-octave totals first.
+ *
+ * A window holds the samples of the last span time units, and at most
+ * capacity samples. Not thread safe: pushing and reading must be serialized
+ * by the caller.
+ */
+
+#define FIFO_WINDOW_SUB_BITS    4
+#define FIFO_WINDOW_OCTAVES     (64 - FIFO_WINDOW_SUB_BITS + 1)
+#define FIFO_WINDOW_BUCKETS     (FIFO_WINDOW_OCTAVES << FIFO_WINDOW_SUB_BITS)
+
+struct fifo_window_sample {
+    uint64_t ts;
+    uint64_t value;
+};
+
+struct fifo_window_entry {
+    uint64_t seq;       /* number of the sample since the window was created */
+    uint64_t value;
+};
+
+struct fifo_window_deque {
+    struct fifo_window_entry *entry;
+    uint64_t head, tail;    /* free-running, slot is index & mask */
+    size_t mask;
+};
+
+typedef struct fifo_window {
+    fifo_buffer *samples;   /* struct fifo_window_sample, oldest first */
+    size_t capacity;
+    uint64_t span;          /* 0 for a window bounded by count only */
+    uint64_t seq;           /* number of the oldest sample in the window */
+    uint64_t sum;
+    size_t count;
+    struct fifo_window_deque min, max;
+    uint32_t octave[FIFO_WINDOW_OCTAVES];
+    uint32_t bucket[FIFO_WINDOW_BUCKETS];
+} fifo_window;
+
+/**
+ * Initialize a fifo_window.
+ * @param capacity maximum number of samples in the window
+ * @param span     age in time units after which a sample leaves the
+ *                 window, 0 to keep the last capacity samples only
+ * @return fifo_window or NULL in case of memory allocation failure
+ */
+fifo_window *fifo_window_alloc(size_t capacity, uint64_t span);
+
+/**
+ * Free a fifo_window.
+ * @param w fifo_window to free, may be NULL
+ */
+void fifo_window_free(fifo_window *w);
+
+/**
+ * Add a sample, evicting those that fell out of the window. The oldest
+ * sample is evicted if the window is full.
+ * @param w     fifo_window to add to
+ * @param ts    timestamp of the sample, not older than the previous one
+ * @param value the sample
+ * @return 0 on success, -EINVAL if ts goes back in time
+ */
+int fifo_window_push(fifo_window *w, uint64_t ts, uint64_t value);
+
+/**
+ * Evict the samples older than now - span, for a window that has not seen
+ * a sample for a while.
+ */
+void fifo_window_expire(fifo_window *w, uint64_t now);
+
+/**
+ * Number of samples in the window.
+ */
+size_t fifo_window_count(const fifo_window *w);
+
+/**
+ * Sum of the samples in the window, modulo 2^64.
+ */
+uint64_t fifo_window_sum(const fifo_window *w);
+
+/**
+ * Mean of the samples in the window, 0 if it is empty.
+ */
+double fifo_window_mean(const fifo_window *w);
+
+/**
+ * Smallest sample in the window, 0 if it is empty.
+ */
+uint64_t fifo_window_min(const fifo_window *w);
+
+/**
+ * Largest sample in the window, 0 if it is empty.
+ */
+uint64_t fifo_window_max(const fifo_window *w);
+
+/**
+ * Approximate quantile of the samples in the window.
+ * @param w fifo_window to query
+ * @param q quantile in [0, 1], e.g. 0.99
+ * @return the middle of the histogram bucket holding the sample of rank
+ *         ceil(q * count), clamped to the window min and max; 0 if empty
+ */
+uint64_t fifo_window_quantile(const fifo_window *w, double q);
+
+#endif /* _FIFO_WINDOW_H */
@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _HASH_H
+#define _HASH_H
+
+/*
+ * Fast hashing routine for ints, longs and pointers.
+ *
+ * Multiplicative hashing: the key is multiplied by an odd constant close
+ * to 2^n / phi and the top bits of the product are kept. The top bits
+ * depend on every bit of the key, the low ones do not, which is why the
+ * result is shifted down rather than masked. It is a single multiply, and
+ * it spreads keys that differ only in their low bits (ids, aligned
+ * pointers) over the whole table.
+ *
+ * Byte strings are hashed with xxh64() and reduced the same way.
+ */
+
+#include <stdint.h>
+#include <compiler.h>
+#include <xxhash.h>
+
+#define GOLDEN_RATIO_32 0x61C88647
+#define GOLDEN_RATIO_64 0x61C8864680B583EBull
+
+#if __SIZEOF_LONG__ == 4
+#define GOLDEN_RATIO_PRIME GOLDEN_RATIO_32
+#define hash_long(val, bits) hash_32(val, bits)
+#else
+#define GOLDEN_RATIO_PRIME GOLDEN_RATIO_64
+#define hash_long(val, bits) hash_64(val, bits)
+#endif
+
+static inline uint32_t __hash_32(uint32_t val)
+{
+	return val * GOLDEN_RATIO_32;
+}
+
+/**
+ * hash_32 - hash a 32-bit value into bits bits
+ * @val: the value to hash
+ * @bits: number of bits of the result, 1 to 32
+ */
+static inline uint32_t hash_32(uint32_t val, unsigned int bits)
+{
+	/* High bits are more random, so use them. */
+	return __hash_32(val) >> (32 - bits);
+}
+
+/**
+ * hash_64 - hash a 64-bit value into bits bits
+ * @val: the value to hash
+ * @bits: number of bits of the result, 1 to 32
+ */
+static __always_inline uint32_t hash_64(uint64_t val, unsigned int bits)
+{
+	/* 64x64-bit multiply is efficient on all 64-bit processors */
+	return val * GOLDEN_RATIO_64 >> (64 - bits);
+}
+
+static inline uint32_t hash_ptr(const void *ptr, unsigned int bits)
+{
+	return hash_long((unsigned long)ptr, bits);
+}
+
+/* This really should be called fold32_ptr; it does no hashing to speak of. */
+static inline uint32_t hash32_ptr(const void *ptr)
+{
+	unsigned long val = (unsigned long)ptr;
+
+#if __SIZEOF_LONG__ == 8
+	val ^= (val >> 32);
+#endif
+	return (uint32_t)val;
+}
+
+/**
+ * hash_mem - hash a byte string into bits bits with xxh64()
+ * @ptr: the bytes to hash
+ * @len: number of bytes
+ * @bits: number of bits of the result, 1 to 32
+ */
+static inline uint32_t hash_mem(const void *ptr, size_t len, unsigned int bits)
+{
+	return xxh64(ptr, len, 0) >> (64 - bits);
+}
+
+#endif /* _HASH_H */
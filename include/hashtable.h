@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Statically sized hash table implementation
+ * (C) 2012  Sasha Levin <levinsasha928@gmail.com>
+ */
+
+#ifndef _HASHTABLE_H
+#define _HASHTABLE_H
+
+#include <list.h>
+#include <hash.h>
+
+/*
+ * The table is an array of hlist_head buckets whose size, a power of two,
+ * is part of its type, so HASH_BITS() is a compile-time constant and every
+ * operation below is an inline macro: the bucket of a key is one multiply
+ * and a shift, and entries are compared by the caller's own expression
+ * inside hash_for_each_possible(), not through a compare callback.
+ *
+ * Integer keys go through hash_min(). Byte string keys go through
+ * hash_mem(), i.e. xxh64(), with the *_mem variants; the same variant
+ * must be used to add and to look up a key.
+ *
+ * Not thread safe; the caller serializes writers against readers.
+ */
+
+#define DEFINE_HASHTABLE(name, bits)						\
+	struct hlist_head name[1 << (bits)] =					\
+			{ [0 ... ((1 << (bits)) - 1)] = HLIST_HEAD_INIT }
+
+#define DECLARE_HASHTABLE(name, bits)                                   	\
+	struct hlist_head name[1 << (bits)]
+
+#define HASH_SIZE(name) (ARRAY_SIZE(name))
+#define HASH_BITS(name) __builtin_ctz(HASH_SIZE(name))
+
+/* Use hash_32 when possible to allow for fast 32bit hashing in 64bit kernels. */
+#define hash_min(val, bits)							\
+	(sizeof(val) <= 4 ? hash_32(val, bits) : hash_long(val, bits))
+
+static inline void __hash_init(struct hlist_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		INIT_HLIST_HEAD(&ht[i]);
+}
+
+/**
+ * hash_init - initialize a hash table
+ * @hashtable: hashtable to be initialized
+ *
+ * Calculates the size of the hashtable from the given parameter, otherwise
+ * same as hash_init_size.
+ *
+ * This has to be a macro since HASH_BITS() will not work on pointers since
+ * it calculates the size during preprocessing.
+ */
+#define hash_init(hashtable) __hash_init(hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_add - add an object to a hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add(hashtable, node, key)						\
+	hlist_add_head(node, &hashtable[hash_min(key, HASH_BITS(hashtable))])
+
+/**
+ * hash_add_mem - add an object keyed by a byte string to a hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_node of the object to be added
+ * @ptr: the key of the object to be added
+ * @len: length of the key in bytes
+ */
+#define hash_add_mem(hashtable, node, ptr, len)					\
+	hlist_add_head(node, &hashtable[hash_mem(ptr, len, HASH_BITS(hashtable))])
+
+/**
+ * hash_hashed - check whether an object is in any hashtable
+ * @node: the &struct hlist_node of the object to be checked
+ */
+static inline bool hash_hashed(struct hlist_node *node)
+{
+	return !hlist_unhashed(node);
+}
+
+static inline bool __hash_empty(struct hlist_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		if (!hlist_empty(&ht[i]))
+			return false;
+
+	return true;
+}
+
+/**
+ * hash_empty - check whether a hashtable is empty
+ * @hashtable: hashtable to check
+ *
+ * This has to be a macro since HASH_BITS() will not work on pointers since
+ * it calculates the size during preprocessing.
+ */
+#define hash_empty(hashtable) __hash_empty(hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_del - remove an object from a hashtable
+ * @node: &struct hlist_node of the object to remove
+ */
+static inline void hash_del(struct hlist_node *node)
+{
+	hlist_del_init(node);
+}
+
+/**
+ * hash_for_each - iterate over a hashtable
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ */
+#define hash_for_each(name, bkt, obj, member)				\
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name);\
+			(bkt)++)\
+		hlist_for_each_entry(obj, &name[bkt], member)
+
+/**
+ * hash_for_each_safe - iterate over a hashtable safe against removal of
+ * hash entry
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @tmp: a &struct hlist_node used for temporary storage
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ */
+#define hash_for_each_safe(name, bkt, tmp, obj, member)			\
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name);\
+			(bkt)++)\
+		hlist_for_each_entry_safe(obj, tmp, &name[bkt], member)
+
+/**
+ * hash_for_each_possible - iterate over all possible objects hashing to the
+ * same bucket
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible(name, obj, member, key)			\
+	hlist_for_each_entry(obj, &name[hash_min(key, HASH_BITS(name))], member)
+
+/**
+ * hash_for_each_possible_safe - iterate over all possible objects hashing to the
+ * same bucket safe against removals
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @tmp: a &struct hlist_node used for temporary storage
+ * @member: the name of the hlist_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible_safe(name, obj, tmp, member, key)	\
+	hlist_for_each_entry_safe(obj, tmp,\
+		&name[hash_min(key, HASH_BITS(name))], member)
+
+/**
+ * hash_for_each_possible_mem - iterate over all possible objects whose byte
+ * string key hashes to the same bucket
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_node within the struct
+ * @ptr: the key of the objects to iterate over
+ * @len: length of the key in bytes
+ */
+#define hash_for_each_possible_mem(name, obj, member, ptr, len)		\
+	hlist_for_each_entry(obj, &name[hash_mem(ptr, len, HASH_BITS(name))], member)
+
+/**
+ * hash_find - look up the object whose integer field equals a key
+ * @name: hashtable to search
+ * @obj: the type * set to the object found, or NULL
+ * @member: the name of the hlist_node within the struct
+ * @field: the name of the key within the struct
+ * @key: the key to look for, evaluated more than once
+ */
+#define hash_find(name, obj, member, field, key)			\
+	do {								\
+		hash_for_each_possible(name, obj, member, key)		\
+			if ((obj)->field == (key))			\
+				break;					\
+	} while (0)
+
+/**
+ * struct hash_stats - occupancy of a hashtable
+ * @size: number of buckets
+ * @used: number of non-empty buckets
+ * @entries: number of objects
+ * @max_chain: length of the longest bucket
+ * @load: entries per bucket
+ */
+struct hash_stats {
+	unsigned int size;
+	unsigned int used;
+	size_t entries;
+	size_t max_chain;
+	double load;
+};
+
+static inline void __hash_stats(struct hlist_head *ht, unsigned int sz,
+				struct hash_stats *st)
+{
+	struct hlist_node *pos;
+	unsigned int i;
+	size_t chain;
+
+	st->size = sz;
+	st->used = 0;
+	st->entries = 0;
+	st->max_chain = 0;
+	for (i = 0; i < sz; i++) {
+		chain = 0;
+		hlist_for_each(pos, &ht[i])
+			chain++;
+		st->used += !!chain;
+		st->entries += chain;
+		if (chain > st->max_chain)
+			st->max_chain = chain;
+	}
+	st->load = (double)st->entries / sz;
+}
+
+/**
+ * hash_stats - walk a hashtable to measure its occupancy
+ * @hashtable: hashtable to measure
+ * @st: &struct hash_stats to fill
+ *
+ * O(size + entries); meant for tuning and debugging, not the fast path.
+ */
+#define hash_stats(hashtable, st) __hash_stats(hashtable, HASH_SIZE(hashtable), st)
+
+#endif /* _HASHTABLE_H */
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_RCULIST_H
+#define _LINUX_RCULIST_H
+
+#include <list.h>
+
+/*
+ * hlist operations for chains that are walked by lock-free readers while
+ * writers, serialized among themselves, modify them.
+ *
+ * A node is initialized before rcu_assign_pointer() publishes it, so a
+ * reader that finds it sees it complete. A removed node keeps its ->next,
+ * so a reader standing on it still reaches the rest of the chain; it may
+ * only be freed once no reader can hold it any more, see ebr.h.
+ */
+
+#define hlist_first_rcu(head)	(*((struct hlist_node **)(&(head)->first)))
+#define hlist_next_rcu(node)	(*((struct hlist_node **)(&(node)->next)))
+
+/**
+ * hlist_del_rcu - deletes entry from hash list without re-initialization
+ * @n: the element to delete from the hash list.
+ *
+ * Readers walking the list may still be on @n and go on through its
+ * ->next, which is left alone. hlist_unhashed() is true afterwards.
+ */
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+	struct hlist_node *next = n->next;
+	struct hlist_node **pprev = n->pprev;
+
+	/*
+	 * A release store even though next was published before: a reader
+	 * that follows this pointer has to see next initialized, and here
+	 * that only follows from C11 release/acquire, not a dependency rule.
+	 */
+	rcu_assign_pointer(*pprev, next);
+	if (next)
+		WRITE_ONCE(next->pprev, pprev);
+	WRITE_ONCE(n->pprev, NULL);
+}
+
+/**
+ * hlist_replace_rcu - replace old entry by new one
+ * @old: the element to be replaced
+ * @new: the new element to insert
+ *
+ * A reader sees either @old or @new in its place, never neither.
+ */
+static inline void hlist_replace_rcu(struct hlist_node *old,
+				     struct hlist_node *new)
+{
+	struct hlist_node *next = old->next;
+
+	new->next = next;
+	WRITE_ONCE(new->pprev, old->pprev);
+	rcu_assign_pointer(*(struct hlist_node **)new->pprev, new);
+	if (next)
+		WRITE_ONCE(new->next->pprev, &new->next);
+	WRITE_ONCE(old->pprev, NULL);
+}
+
+/**
+ * hlist_add_head_rcu - adds the specified element to the head of a hash list
+ * @n: the element to add to the hash list.
+ * @h: the list to add to.
+ */
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+				      struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	WRITE_ONCE(n->pprev, &h->first);
+	rcu_assign_pointer(hlist_first_rcu(h), n);
+	if (first)
+		WRITE_ONCE(first->pprev, &n->next);
+}
+
+/**
+ * hlist_for_each_entry_rcu - iterate over rcu list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ *
+ * Safe against concurrent hlist_*_rcu() writers as long as the walk runs
+ * in a read-side critical section.
+ */
+#define hlist_for_each_entry_rcu(pos, head, member)			\
+	for (pos = hlist_entry_safe(rcu_dereference(hlist_first_rcu(head)), \
+				    typeof(*(pos)), member);		\
+	     pos;							\
+	     pos = hlist_entry_safe(rcu_dereference(hlist_next_rcu(	\
+				    &(pos)->member)), typeof(*(pos)), member))
+
+#endif /* _LINUX_RCULIST_H */
@@ -0,0 +1,209 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _RHASH_H
+#define _RHASH_H
+
+#include <list.h>
+#include <hash.h>
+
+/*
+ * Resizable hash table of hlist_head buckets with incremental rehashing.
+ *
+ * The table doubles when it holds more entries than buckets and shrinks
+ * when it is less than 1/8 full. Resizing never moves all entries at
+ * once: it allocates the new bucket array and from then on every
+ * rhash_add() and rhash_find() migrates a few buckets of the old array
+ * (RHASH_STEP), so the cost of a resize is spread over the operations
+ * that follow it. Until the old array is drained, lookups consult both;
+ * an old bucket below rehash_idx is known to be empty and is skipped.
+ * An idle owner can finish a resize early with rhash_rehash().
+ *
+ * Every entry embeds a struct rhash_node, which keeps the 64-bit hash of
+ * its key so that migration never calls back into the user. The bucket is
+ * taken from the top bits of the hash, so the hash must be well mixed
+ * there: xxh64() of the key, or rhash_int() of an integer key. Keys are
+ * compared by the caller's expression in rhash_find(), after the stored
+ * hashes matched.
+ *
+ * Not thread safe; the owner serializes all operations. While walking the
+ * table with rhash_for_each*(), only rhash_del() may be called, it never
+ * migrates buckets.
+ */
+
+#define RHASH_MIN_BITS	4
+#define RHASH_STEP	4	/* buckets migrated per operation */
+
+struct rhash_node {
+	struct hlist_node node;	/* first, rhash_rehash() casts to it */
+	uint64_t hash;
+};
+
+struct rhash_table {
+	struct hlist_head *tbl[2];	/* tbl[1] is the target of a resize */
+	unsigned int bits[2];
+	size_t nelems;
+	size_t rehash_idx;		/* tbl[0] buckets below it are empty */
+	unsigned int min_bits;
+};
+
+/**
+ * rhash_int - hash of an integer key for rhash_add()/rhash_find()
+ * @key: the key
+ *
+ * A bijection, so equal hashes mean equal keys.
+ */
+static inline uint64_t rhash_int(uint64_t key)
+{
+	return key * GOLDEN_RATIO_64;
+}
+
+/**
+ * rhash_init - initialize an empty table
+ * @t: table to initialize
+ * @min_bits: log2 of the initial and smallest bucket count, at least
+ *            RHASH_MIN_BITS is used
+ *
+ * Return: 0, or -ENOMEM
+ */
+int rhash_init(struct rhash_table *t, unsigned int min_bits);
+
+/**
+ * rhash_destroy - free the buckets of a table, not the entries
+ * @t: table to destroy
+ */
+void rhash_destroy(struct rhash_table *t);
+
+/**
+ * rhash_add - insert an entry
+ * @t: table to insert into
+ * @n: the &struct rhash_node of the entry, not in any table
+ * @hash: hash of the key of the entry
+ *
+ * Never fails: if a larger bucket array cannot be allocated the table
+ * keeps its size and its chains grow.
+ */
+void rhash_add(struct rhash_table *t, struct rhash_node *n, uint64_t hash);
+
+/**
+ * rhash_del - remove an entry
+ * @t: table the entry is in
+ * @n: the &struct rhash_node of the entry
+ */
+void rhash_del(struct rhash_table *t, struct rhash_node *n);
+
+/**
+ * rhash_rehash - migrate buckets of a resize in progress
+ * @t: table to work on
+ * @nb_buckets: maximum number of old buckets to migrate, SIZE_MAX to finish
+ *
+ * Return: true if a resize is still in progress
+ */
+bool rhash_rehash(struct rhash_table *t, size_t nb_buckets);
+
+static inline size_t rhash_count(const struct rhash_table *t)
+{
+	return t->nelems;
+}
+
+static inline size_t rhash_size(const struct rhash_table *t, int k)
+{
+	return t->tbl[k] ? (size_t)1 << t->bits[k] : 0;
+}
+
+static inline bool rhash_rehashing(const struct rhash_table *t)
+{
+	return t->tbl[1];
+}
+
+static inline void rhash_step(struct rhash_table *t)
+{
+	if (unlikely(rhash_rehashing(t)))
+		rhash_rehash(t, RHASH_STEP);
+}
+
+/* Bucket of a hash in tbl[k], NULL if that table cannot hold it. */
+static inline struct hlist_head *rhash_bucket(const struct rhash_table *t,
+					      uint64_t hash, int k)
+{
+	size_t idx;
+
+	if (!t->tbl[k])
+		return NULL;
+	idx = hash >> (64 - t->bits[k]);
+	if (!k && idx < t->rehash_idx)
+		return NULL;
+	return &t->tbl[k][idx];
+}
+
+/* Bucket idx of the concatenation of tbl[0] and tbl[1]. */
+static inline struct hlist_head *rhash_bucket_at(const struct rhash_table *t,
+						 size_t idx)
+{
+	size_t size0 = rhash_size(t, 0);
+
+	return idx < size0 ? &t->tbl[0][idx] : &t->tbl[1][idx - size0];
+}
+
+/**
+ * rhash_find - look up an entry
+ * @t: table to search
+ * @obj: the type * set to the entry found, or NULL
+ * @member: the name of the &struct rhash_node within the struct
+ * @hash_: hash of the key to look for
+ * @cond: expression of obj true for the entry looked for, evaluated only
+ *        for entries with the same hash
+ *
+ * Migrates RHASH_STEP buckets first if a resize is in progress.
+ */
+#define rhash_find(t, obj, member, hash_, cond)				\
+	do {								\
+		struct rhash_node *__n;					\
+		uint64_t __h = (hash_);					\
+		int __k;						\
+									\
+		rhash_step(t);						\
+		obj = NULL;						\
+		for (__k = 0; __k < 2 && !obj; __k++) {			\
+			struct hlist_head *__b = rhash_bucket(t, __h, __k); \
+									\
+			if (!__b)					\
+				continue;				\
+			hlist_for_each_entry(__n, __b, node) {		\
+				if (__n->hash != __h)			\
+					continue;			\
+				obj = container_of(__n, typeof(*(obj)), member); \
+				if (cond)				\
+					break;				\
+				obj = NULL;				\
+			}						\
+		}							\
+	} while (0)
+
+/**
+ * rhash_for_each - iterate over all entries
+ * @t: table to iterate
+ * @bkt: size_t to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the &struct rhash_node within the struct
+ */
+#define rhash_for_each(t, bkt, obj, member)				\
+	for ((bkt) = 0, obj = NULL;					\
+	     obj == NULL && (bkt) < rhash_size(t, 0) + rhash_size(t, 1); \
+	     (bkt)++)							\
+		hlist_for_each_entry(obj, rhash_bucket_at(t, bkt), member.node)
+
+/**
+ * rhash_for_each_safe - iterate over all entries, safe against rhash_del()
+ * @t: table to iterate
+ * @bkt: size_t to use as bucket loop cursor
+ * @tmp: a &struct hlist_node used for temporary storage
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the &struct rhash_node within the struct
+ */
+#define rhash_for_each_safe(t, bkt, tmp, obj, member)			\
+	for ((bkt) = 0, obj = NULL;					\
+	     obj == NULL && (bkt) < rhash_size(t, 0) + rhash_size(t, 1); \
+	     (bkt)++)							\
+		hlist_for_each_entry_safe(obj, tmp, rhash_bucket_at(t, bkt), \
+					  member.node)
+
+#endif /* _RHASH_H */
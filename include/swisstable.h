@@ -0,0 +1,388 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _SWISSTABLE_H
+#define _SWISSTABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <compiler.h>
+#include <xxhash.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Open addressing hash map with one control byte per slot (Swiss table).
+ *
+ * Keys and values live inline in one slot array. Next to it is an array
+ * of control bytes, one per slot: EMPTY, DELETED, or for a full slot the
+ * low 7 bits of the hash of its key (h2). The slots are split into groups
+ * of 16. A key starts probing at the group picked by the rest of its hash
+ * (h1), and a group is searched by comparing its 16 control bytes against
+ * h2 at once, one SSE2 compare and movemask, so keys are only compared
+ * for the rare slots whose tag matches, usually in one cache line. A
+ * probe stops at the first group that has an EMPTY slot; groups are
+ * visited in triangular order, which covers them all.
+ *
+ * The table grows at a load of 7/8. A deleted slot becomes EMPTY if its
+ * group has an EMPTY slot, since no probe went past that group; otherwise
+ * it is marked DELETED so that probes continue, and reused by inserts.
+ * Rehashing also drops the tombstones, without growing if they made up
+ * most of the load.
+ *
+ * DEFINE_SWISSTABLE(name, key_type, val_type, hash, equal) generates a
+ * typed map struct name and static inline functions name_init(),
+ * name_destroy(), name_reserve(), name_find(), name_get(), name_put(),
+ * name_del(), name_count() and name_get_batch(). hash(key) returns a
+ * uint64_t, equal(a, b) compares two keys; both are macros or inline
+ * functions, so the probe loop is specialized for the key type with no
+ * indirect calls:
+ *
+ *   DEFINE_SWISSTABLE(flow_map, uint64_t, uint32_t, swiss_hash_u64,
+ *                     SWISS_EQ_SCALAR)
+ *
+ * Not thread safe. Slot pointers are valid until the next insert.
+ */
+
+#define SWISS_GROUP	16
+#define SWISS_EMPTY	((uint8_t)0x80)
+#define SWISS_DELETED	((uint8_t)0xfe)
+#define SWISS_BATCH	16	/* keys whose misses name_get_batch() overlaps */
+
+#define swiss_full(c)		(!((c) & 0x80))
+#define SWISS_EQ_SCALAR(a, b)	((a) == (b))
+
+/* xxh64() of the 8 little-endian bytes of key, without a call. */
+static __always_inline uint64_t swiss_hash_u64(uint64_t key)
+{
+	const uint64_t p1 = 11400714785074694791ULL;
+	const uint64_t p2 = 14029467366897019727ULL;
+	const uint64_t p3 =  1609587929392839161ULL;
+	const uint64_t p4 =  9650029242287828579ULL;
+	const uint64_t p5 =  2870177450012600261ULL;
+	uint64_t h = p5 + 8, k = key * p2;
+
+	k = (k << 31 | k >> 33) * p1;
+	h ^= k;
+	h = (h << 27 | h >> 37) * p1 + p4;
+	h ^= h >> 33;
+	h *= p2;
+	h ^= h >> 29;
+	h *= p3;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline uint64_t swiss_hash_mem(const void *key, size_t len)
+{
+	return xxh64(key, len, 0);
+}
+
+/* Control bytes of a table without slots: every lookup ends at once. */
+static const uint8_t swiss_empty_group[SWISS_GROUP] __aligned(SWISS_GROUP) = {
+	[0 ... SWISS_GROUP - 1] = SWISS_EMPTY,
+};
+
+#ifdef __SSE2__
+static __always_inline unsigned int swiss_match(const uint8_t *g, uint8_t h2)
+{
+	__m128i ctrl = _mm_load_si128((const __m128i *)g);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+
+static __always_inline unsigned int swiss_match_empty(const uint8_t *g)
+{
+	__m128i ctrl = _mm_load_si128((const __m128i *)g);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl,
+					_mm_set1_epi8((char)SWISS_EMPTY)));
+}
+
+/* EMPTY and DELETED are the control bytes with the sign bit set. */
+static __always_inline unsigned int swiss_match_free(const uint8_t *g)
+{
+	return _mm_movemask_epi8(_mm_load_si128((const __m128i *)g));
+}
+#else
+static __always_inline unsigned int swiss_match(const uint8_t *g, uint8_t h2)
+{
+	unsigned int i, m = 0;
+
+	for (i = 0; i < SWISS_GROUP; i++)
+		m |= (unsigned int)(g[i] == h2) << i;
+	return m;
+}
+
+static __always_inline unsigned int swiss_match_empty(const uint8_t *g)
+{
+	return swiss_match(g, SWISS_EMPTY);
+}
+
+static __always_inline unsigned int swiss_match_free(const uint8_t *g)
+{
+	unsigned int i, m = 0;
+
+	for (i = 0; i < SWISS_GROUP; i++)
+		m |= (unsigned int)!swiss_full(g[i]) << i;
+	return m;
+}
+#endif /* __SSE2__ */
+
+/* Slots that can be filled before the table has to grow. */
+static inline size_t swiss_max_load(size_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+#define DEFINE_SWISSTABLE(name, key_type, val_type, hash, equal)	\
+									\
+struct name##_slot {							\
+	key_type key;							\
+	val_type val;							\
+};									\
+									\
+struct name {								\
+	uint8_t *ctrl;							\
+	struct name##_slot *slots;					\
+	size_t capacity;	/* slots, 0 or a power of two >= 16 */	\
+	size_t count;							\
+	size_t growth_left;	/* EMPTY slots that may still be used */ \
+};									\
+									\
+static inline void name##_init(struct name *t)				\
+{									\
+	t->ctrl = (uint8_t *)swiss_empty_group;				\
+	t->slots = NULL;						\
+	t->capacity = 0;						\
+	t->count = 0;							\
+	t->growth_left = 0;						\
+}									\
+									\
+static inline void name##_destroy(struct name *t)			\
+{									\
+	if (t->capacity)						\
+		free(t->ctrl);						\
+	name##_init(t);							\
+}									\
+									\
+static inline size_t name##_count(const struct name *t)		\
+{									\
+	return t->count;						\
+}									\
+									\
+/* Mask of the group indices, a group of capacity 0 is the empty one. */ \
+static inline size_t name##_gmask(const struct name *t)		\
+{									\
+	return t->capacity ? t->capacity / SWISS_GROUP - 1 : 0;		\
+}									\
+									\
+static inline struct name##_slot *name##_find_hash(const struct name *t, \
+						   key_type key,	\
+						   uint64_t h)		\
+{									\
+	size_t gmask = name##_gmask(t), g = (h >> 7) & gmask, step = 0; \
+	uint8_t h2 = h & 0x7f;						\
+									\
+	for (;;) {							\
+		const uint8_t *ctrl = t->ctrl + g * SWISS_GROUP;	\
+		unsigned int m = swiss_match(ctrl, h2);			\
+									\
+		while (m) {						\
+			size_t i = g * SWISS_GROUP + __builtin_ctz(m);	\
+									\
+			if (likely(equal(t->slots[i].key, key)))	\
+				return &t->slots[i];			\
+			m &= m - 1;					\
+		}							\
+		if (likely(swiss_match_empty(ctrl)))			\
+			return NULL;					\
+		g = (g + ++step) & gmask;				\
+	}								\
+}									\
+									\
+static inline struct name##_slot *name##_find(const struct name *t,	\
+					      key_type key)		\
+{									\
+	return name##_find_hash(t, key, hash(key));			\
+}									\
+									\
+static inline val_type *name##_get(const struct name *t, key_type key)	\
+{									\
+	struct name##_slot *s = name##_find(t, key);			\
+									\
+	return s ? &s->val : NULL;					\
+}									\
+									\
+/**									\
+ * name##_get_batch - look up n keys, overlapping their cache misses	\
+ * @vals: receives a pointer to the value of each key, or NULL		\
+ *									\
+ * The control groups of a batch of keys are prefetched before any is	\
+ * probed, then the slots their tags point to, so the memory latency	\
+ * of a table much larger than the cache is paid once per batch.	\
+ */									\
+static inline void name##_get_batch(const struct name *t,		\
+				    const key_type *keys, size_t n,	\
+				    val_type **vals)			\
+{									\
+	uint64_t h[SWISS_BATCH];					\
+	size_t gmask = name##_gmask(t), i, j, nb;			\
+									\
+	for (i = 0; i < n; i += nb) {					\
+		nb = min((size_t)SWISS_BATCH, n - i);			\
+		for (j = 0; j < nb; j++) {				\
+			h[j] = hash(keys[i + j]);			\
+			__builtin_prefetch(t->ctrl +			\
+				((h[j] >> 7) & gmask) * SWISS_GROUP);	\
+		}							\
+		for (j = 0; j < nb; j++) {				\
+			size_t g = (h[j] >> 7) & gmask;			\
+			unsigned int m = swiss_match(t->ctrl +		\
+						g * SWISS_GROUP,	\
+						h[j] & 0x7f);		\
+									\
+			if (m)						\
+				__builtin_prefetch(&t->slots[g * SWISS_GROUP + \
+							 __builtin_ctz(m)]); \
+		}							\
+		for (j = 0; j < nb; j++) {				\
+			struct name##_slot *s = name##_find_hash(t,	\
+						keys[i + j], h[j]);	\
+									\
+			vals[i + j] = s ? &s->val : NULL;		\
+		}							\
+	}								\
+}									\
+									\
+/* First EMPTY or DELETED slot on the probe sequence of h. */		\
+static inline size_t name##_find_free(const struct name *t, uint64_t h) \
+{									\
+	size_t gmask = name##_gmask(t), g = (h >> 7) & gmask, step = 0; \
+	unsigned int m;							\
+									\
+	while (!(m = swiss_match_free(t->ctrl + g * SWISS_GROUP)))	\
+		g = (g + ++step) & gmask;				\
+	return g * SWISS_GROUP + __builtin_ctz(m);			\
+}									\
+									\
+static inline int name##_resize(struct name *t, size_t capacity)	\
+{									\
+	struct name old = *t;						\
+	size_t i, pos;							\
+	void *mem;							\
+									\
+	if (posix_memalign(&mem, 64, capacity +				\
+			   capacity * sizeof(struct name##_slot)))	\
+		return -ENOMEM;						\
+	t->ctrl = mem;							\
+	t->slots = (struct name##_slot *)(t->ctrl + capacity);		\
+	t->capacity = capacity;						\
+	t->growth_left = swiss_max_load(capacity) - t->count;		\
+	memset(t->ctrl, SWISS_EMPTY, capacity);				\
+									\
+	for (i = 0; i < old.capacity; i++) {				\
+		uint64_t h;						\
+									\
+		if (!swiss_full(old.ctrl[i]))				\
+			continue;					\
+		h = hash(old.slots[i].key);				\
+		pos = name##_find_free(t, h);				\
+		t->ctrl[pos] = h & 0x7f;				\
+		t->slots[pos] = old.slots[i];				\
+	}								\
+	if (old.capacity)						\
+		free(old.ctrl);						\
+	return 0;							\
+}									\
+									\
+/**									\
+ * name##_reserve - make room for count entries without rehashing	\
+ * Return: 0, or -ENOMEM						\
+ */									\
+static inline int name##_reserve(struct name *t, size_t count)		\
+{									\
+	size_t capacity = SWISS_GROUP;					\
+									\
+	while (swiss_max_load(capacity) < count)			\
+		capacity *= 2;						\
+	if (capacity <= t->capacity)					\
+		return 0;						\
+	return name##_resize(t, capacity);				\
+}									\
+									\
+/* Out of EMPTY slots: grow, or only drop tombstones if they are many. */ \
+static inline int name##_rehash(struct name *t)			\
+{									\
+	size_t capacity = t->capacity ? t->capacity : SWISS_GROUP;	\
+									\
+	if (t->count >= swiss_max_load(capacity) / 2)			\
+		capacity *= 2;						\
+	return name##_resize(t, capacity);				\
+}									\
+									\
+/**									\
+ * name##_put - insert key or replace its value				\
+ * Return: 1 if the key was added, 0 if it was present, -ENOMEM		\
+ */									\
+static inline int name##_put(struct name *t, key_type key, val_type val) \
+{									\
+	uint64_t h = hash(key);						\
+	struct name##_slot *s = name##_find_hash(t, key, h);		\
+	size_t pos;							\
+									\
+	if (s) {							\
+		s->val = val;						\
+		return 0;						\
+	}								\
+	pos = name##_find_free(t, h);					\
+	if (unlikely(!t->growth_left && t->ctrl[pos] == SWISS_EMPTY)) { \
+		if (name##_rehash(t))					\
+			return -ENOMEM;					\
+		pos = name##_find_free(t, h);				\
+	}								\
+	t->growth_left -= t->ctrl[pos] == SWISS_EMPTY;			\
+	t->ctrl[pos] = h & 0x7f;					\
+	t->slots[pos].key = key;					\
+	t->slots[pos].val = val;					\
+	t->count++;							\
+	return 1;							\
+}									\
+									\
+/**									\
+ * name##_del - remove key						\
+ * Return: true if it was present					\
+ */									\
+static inline bool name##_del(struct name *t, key_type key)		\
+{									\
+	struct name##_slot *s = name##_find(t, key);			\
+	size_t pos;							\
+									\
+	if (!s)								\
+		return false;						\
+	pos = s - t->slots;						\
+	if (swiss_match_empty(t->ctrl + (pos & ~(size_t)(SWISS_GROUP - 1)))) { \
+		t->ctrl[pos] = SWISS_EMPTY;				\
+		t->growth_left++;					\
+	} else {							\
+		t->ctrl[pos] = SWISS_DELETED;				\
+	}								\
+	t->count--;							\
+	return true;							\
+}
+
+/**
+ * swiss_for_each - iterate over the entries of a map
+ * @t: the map
+ * @i: size_t to use as slot index cursor
+ * @slot: the struct name_slot * to use as a loop cursor
+ *
+ * The current entry may be deleted, entries may not be added.
+ */
+#define swiss_for_each(t, i, slot)					\
+	for ((i) = 0; (i) < (t)->capacity; (i)++)			\
+		if (swiss_full((t)->ctrl[i]) && ((slot) = &(t)->slots[i], 1))
+
+#endif /* _SWISSTABLE_H */
@@ -108,6 +108,34 @@ uint32_t xxh32(const void *input, size_t length, uint32_t seed);
  */
 uint64_t xxh64(const void *input, size_t length, uint64_t seed);
 
+/**
+ * xxh64_batch() - calculate the xxh64() hashes of n keys at once.
+ *
+ * @keys:  The keys to hash.
+ * @lens:  The length of every key.
+ * @n:     The number of keys.
+ * @seed:  The seed used for every key.
+ * @out:   Receives xxh64(keys[i], lens[i], seed) in out[i].
+ *
+ * Keys shorter than 32 bytes are hashed several at a time with their rounds
+ * interleaved, which keeps the multiplier busy where hashing them one by one
+ * waits on a single dependency chain.
+ */
+void xxh64_batch(const void *const *keys, const size_t *lens, size_t n,
+		 uint64_t seed, uint64_t *out);
+
+/**
+ * xxh64_batch_fixed() - calculate the xxh64() hashes of n keys of one size.
+ *
+ * @keys:     The keys to hash, stored back to back.
+ * @key_size: The length of every key.
+ * @n:        The number of keys.
+ * @seed:     The seed used for every key.
+ * @out:      Receives the hash of key i in out[i].
+ */
+void xxh64_batch_fixed(const void *keys, size_t key_size, size_t n,
+		       uint64_t seed, uint64_t *out);
+
 /*-****************************
  * Streaming Hash Functions
  *****************************/
@@ -214,6 +242,127 @@ int xxh64_update(struct xxh64_state *state, const void *input, size_t length);
  */
 uint64_t xxh64_digest(const struct xxh64_state *state);
 
+/*-****************************
+ * XXH3
+ *****************************/
+
+/*
+ * XXH3 is a newer member of the family. It hashes keys of up to 240 bytes
+ * with dedicated branch-light code paths, which are several times faster
+ * than xxh64() on short keys, and larger inputs with 8 independent 64-bit
+ * lanes, processed with SSE2, AVX2 or AVX-512 as cpu_level() allows. Its
+ * results are unrelated to those of xxh32() and xxh64().
+ */
+
+/**
+ * struct xxh128_hash - a 128-bit XXH3 hash
+ */
+struct xxh128_hash {
+	uint64_t low64;
+	uint64_t high64;
+};
+
+/**
+ * xxh3_64() - calculate the 64-bit XXH3 hash of the input with a given seed.
+ *
+ * @input:  The data to hash.
+ * @length: The length of the data to hash.
+ * @seed:   The seed can be used to alter the result predictably.
+ *
+ * Return:  The 64-bit hash of the data.
+ */
+uint64_t xxh3_64(const void *input, size_t length, uint64_t seed);
+
+/**
+ * xxh3_128() - calculate the 128-bit XXH3 hash of the input with a given seed.
+ *
+ * @input:  The data to hash.
+ * @length: The length of the data to hash.
+ * @seed:   The seed can be used to alter the result predictably.
+ *
+ * Return:  The 128-bit hash of the data.
+ */
+struct xxh128_hash xxh3_128(const void *input, size_t length, uint64_t seed);
+
+#define XXH3_SECRET_SIZE	192
+#define XXH3_BUFFER_SIZE	256
+
+/**
+ * struct xxh3_state - private XXH3 state, do not use members directly
+ *
+ * The same state serves the 64-bit and the 128-bit hash.
+ */
+struct xxh3_state {
+	uint64_t acc[8];
+	uint8_t custom_secret[XXH3_SECRET_SIZE];
+	uint8_t buffer[XXH3_BUFFER_SIZE];
+	uint32_t buffered_size;
+	uint32_t nb_stripes_so_far;
+	uint64_t total_len;
+	uint64_t seed;
+};
+
+/**
+ * xxh3_64_reset() - reset the XXH3 state to start a new 64-bit hash
+ *
+ * @state: The XXH3 state to reset.
+ * @seed:  Initialize the hash state with this seed.
+ */
+void xxh3_64_reset(struct xxh3_state *state, uint64_t seed);
+
+/**
+ * xxh3_64_update() - hash the data given and update the XXH3 state
+ *
+ * @state:  The XXH3 state to update.
+ * @input:  The data to hash.
+ * @length: The length of the data to hash.
+ *
+ * After calling xxh3_64_reset() call xxh3_64_update() as many times as
+ * necessary.
+ *
+ * Return:  Zero on success, otherwise an error code.
+ */
+int xxh3_64_update(struct xxh3_state *state, const void *input, size_t length);
+
+/**
+ * xxh3_64_digest() - produce the current 64-bit XXH3 hash
+ *
+ * @state: Produce the current XXH3 hash of this state.
+ *
+ * As with xxh64_digest(), more input may be added after a digest.
+ *
+ * Return: The 64-bit XXH3 hash stored in the state.
+ */
+uint64_t xxh3_64_digest(const struct xxh3_state *state);
+
+/**
+ * xxh3_128_reset() - reset the XXH3 state to start a new 128-bit hash
+ *
+ * @state: The XXH3 state to reset.
+ * @seed:  Initialize the hash state with this seed.
+ */
+void xxh3_128_reset(struct xxh3_state *state, uint64_t seed);
+
+/**
+ * xxh3_128_update() - hash the data given and update the XXH3 state
+ *
+ * @state:  The XXH3 state to update.
+ * @input:  The data to hash.
+ * @length: The length of the data to hash.
+ *
+ * Return:  Zero on success, otherwise an error code.
+ */
+int xxh3_128_update(struct xxh3_state *state, const void *input, size_t length);
+
+/**
+ * xxh3_128_digest() - produce the current 128-bit XXH3 hash
+ *
+ * @state: Produce the current XXH3 hash of this state.
+ *
+ * Return: The 128-bit XXH3 hash stored in the state.
+ */
+struct xxh128_hash xxh3_128_digest(const struct xxh3_state *state);
+
 /*-**************************
  * Utils
  ***************************/
@@ -234,4 +383,12 @@ void xxh32_copy_state(struct xxh32_state *dst, const struct xxh32_state *src);
  */
 void xxh64_copy_state(struct xxh64_state *dst, const struct xxh64_state *src);
 
+/**
+ * xxh3_copy_state() - copy the source state into the destination state
+ *
+ * @src: The source XXH3 state.
+ * @dst: The destination XXH3 state.
+ */
+void xxh3_copy_state(struct xxh3_state *dst, const struct xxh3_state *src);
+
 #endif /* XXHASH_H */
@@ -0,0 +1,279 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * constexpr xxh32() and xxh64(), bit-identical to the ones of xxhash.c, so
+ * names known at compile time can be hashed by the compiler and compared
+ * against runtime hashes of incoming strings:
+ *
+ *   using namespace xxhash::literals;
+ *
+ *   switch (::xxh64(name, len, 0)) {
+ *   case "start"_xxh64: ...
+ *   case "stop"_xxh64: ...
+ *   }
+ *
+ * The literals hash with seed 0; the runtime hash has to use the same seed.
+ * A collision between two case labels is a compile error, a collision of an
+ * unknown name with a label is not, so a match should still be confirmed
+ * with a string compare where it matters.
+ *
+ * Requires C++14. Define XXHASH_HPP_SELFTEST in one translation unit to
+ * check the constexpr functions at compile time against hashes computed
+ * by xxhash.c.
+ */
+
+#ifndef XXHASH_HPP
+#define XXHASH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+extern "C" {
+#include <xxhash.h>
+}
+
+namespace xxhash {
+
+namespace detail {
+
+constexpr uint32_t PRIME32_1 = 2654435761U;
+constexpr uint32_t PRIME32_2 = 2246822519U;
+constexpr uint32_t PRIME32_3 = 3266489917U;
+constexpr uint32_t PRIME32_4 =  668265263U;
+constexpr uint32_t PRIME32_5 =  374761393U;
+
+constexpr uint64_t PRIME64_1 = 11400714785074694791ULL;
+constexpr uint64_t PRIME64_2 = 14029467366897019727ULL;
+constexpr uint64_t PRIME64_3 =  1609587929392839161ULL;
+constexpr uint64_t PRIME64_4 =  9650029242287828579ULL;
+constexpr uint64_t PRIME64_5 =  2870177450012600261ULL;
+
+constexpr uint32_t rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+constexpr uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+/* Bytes are assembled one at a time, reinterpreting memory is not constexpr. */
+constexpr uint32_t read_le32(const char *p)
+{
+	return (uint32_t)(uint8_t)p[0] | (uint32_t)(uint8_t)p[1] << 8 |
+	       (uint32_t)(uint8_t)p[2] << 16 | (uint32_t)(uint8_t)p[3] << 24;
+}
+
+constexpr uint64_t read_le64(const char *p)
+{
+	return (uint64_t)read_le32(p) | (uint64_t)read_le32(p + 4) << 32;
+}
+
+constexpr uint32_t xxh32_round(uint32_t seed, uint32_t input)
+{
+	return rotl32(seed + input * PRIME32_2, 13) * PRIME32_1;
+}
+
+constexpr uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+	return rotl64(acc + input * PRIME64_2, 31) * PRIME64_1;
+}
+
+constexpr uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+	return (acc ^ xxh64_round(0, val)) * PRIME64_1 + PRIME64_4;
+}
+
+} /* namespace detail */
+
+/**
+ * xxh32() - calculate the 32-bit hash of the input with a given seed.
+ *
+ * Return:  The same value as xxh32() of xxhash.c.
+ */
+constexpr uint32_t xxh32(const char *input, size_t len, uint32_t seed = 0)
+{
+	using namespace detail;
+	const char *p = input;
+	const char *const b_end = p + len;
+	uint32_t h32 = 0;
+
+	if (len >= 16) {
+		const char *const limit = b_end - 16;
+		uint32_t v1 = seed + PRIME32_1 + PRIME32_2;
+		uint32_t v2 = seed + PRIME32_2;
+		uint32_t v3 = seed + 0;
+		uint32_t v4 = seed - PRIME32_1;
+
+		do {
+			v1 = xxh32_round(v1, read_le32(p));
+			v2 = xxh32_round(v2, read_le32(p + 4));
+			v3 = xxh32_round(v3, read_le32(p + 8));
+			v4 = xxh32_round(v4, read_le32(p + 12));
+			p += 16;
+		} while (p <= limit);
+
+		h32 = rotl32(v1, 1) + rotl32(v2, 7) +
+			rotl32(v3, 12) + rotl32(v4, 18);
+	} else {
+		h32 = seed + PRIME32_5;
+	}
+
+	h32 += (uint32_t)len;
+
+	while (p + 4 <= b_end) {
+		h32 += read_le32(p) * PRIME32_3;
+		h32 = rotl32(h32, 17) * PRIME32_4;
+		p += 4;
+	}
+
+	while (p < b_end) {
+		h32 += (uint8_t)*p * PRIME32_5;
+		h32 = rotl32(h32, 11) * PRIME32_1;
+		p++;
+	}
+
+	h32 ^= h32 >> 15;
+	h32 *= PRIME32_2;
+	h32 ^= h32 >> 13;
+	h32 *= PRIME32_3;
+	h32 ^= h32 >> 16;
+
+	return h32;
+}
+
+/**
+ * xxh64() - calculate the 64-bit hash of the input with a given seed.
+ *
+ * Return:  The same value as xxh64() of xxhash.c.
+ */
+constexpr uint64_t xxh64(const char *input, size_t len, uint64_t seed = 0)
+{
+	using namespace detail;
+	const char *p = input;
+	const char *const b_end = p + len;
+	uint64_t h64 = 0;
+
+	if (len >= 32) {
+		const char *const limit = b_end - 32;
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed + 0;
+		uint64_t v4 = seed - PRIME64_1;
+
+		do {
+			v1 = xxh64_round(v1, read_le64(p));
+			v2 = xxh64_round(v2, read_le64(p + 8));
+			v3 = xxh64_round(v3, read_le64(p + 16));
+			v4 = xxh64_round(v4, read_le64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h64 = rotl64(v1, 1) + rotl64(v2, 7) +
+			rotl64(v3, 12) + rotl64(v4, 18);
+		h64 = xxh64_merge_round(h64, v1);
+		h64 = xxh64_merge_round(h64, v2);
+		h64 = xxh64_merge_round(h64, v3);
+		h64 = xxh64_merge_round(h64, v4);
+	} else {
+		h64 = seed + PRIME64_5;
+	}
+
+	h64 += (uint64_t)len;
+
+	while (p + 8 <= b_end) {
+		h64 ^= xxh64_round(0, read_le64(p));
+		h64 = rotl64(h64, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+
+	if (p + 4 <= b_end) {
+		h64 ^= (uint64_t)read_le32(p) * PRIME64_1;
+		h64 = rotl64(h64, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	while (p < b_end) {
+		h64 ^= (uint8_t)*p * PRIME64_5;
+		h64 = rotl64(h64, 11) * PRIME64_1;
+		p++;
+	}
+
+	h64 ^= h64 >> 33;
+	h64 *= PRIME64_2;
+	h64 ^= h64 >> 29;
+	h64 *= PRIME64_3;
+	h64 ^= h64 >> 32;
+
+	return h64;
+}
+
+#if __cplusplus >= 201703L
+constexpr uint32_t xxh32(std::string_view s, uint32_t seed = 0)
+{
+	return xxh32(s.data(), s.size(), seed);
+}
+
+constexpr uint64_t xxh64(std::string_view s, uint64_t seed = 0)
+{
+	return xxh64(s.data(), s.size(), seed);
+}
+#endif
+
+inline namespace literals {
+
+constexpr uint32_t operator""_xxh32(const char *s, size_t len)
+{
+	return xxh32(s, len, 0);
+}
+
+constexpr uint64_t operator""_xxh64(const char *s, size_t len)
+{
+	return xxh64(s, len, 0);
+}
+
+} /* namespace literals */
+
+#ifdef XXHASH_HPP_SELFTEST
+/*
+ * Hashes computed by xxhash.c, covering the empty input, the byte tail, the
+ * 4-byte tail, one xxh32 stripe and several xxh64 stripes, with and
+ * without a seed.
+ */
+namespace detail {
+
+constexpr char test_long[] =
+	"0123456789abcdefghijklmnopqrstuvwxyz-ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static_assert(""_xxh32 == 0x02cc5d05U, "xxh32 empty");
+static_assert("a"_xxh32 == 0x550d7456U, "xxh32 1 byte");
+static_assert("abc"_xxh32 == 0x32d153ffU, "xxh32 3 bytes");
+static_assert("xxhash-constexpr"_xxh32 == 0xc00280eeU, "xxh32 16 bytes");
+static_assert(xxh32(test_long, sizeof(test_long) - 1, 0) == 0x3348648eU,
+	      "xxh32 63 bytes");
+static_assert(xxh32("abc", 3, PRIME32_1) == 0xa1ae7709U, "xxh32 seeded");
+static_assert(xxh32(test_long, sizeof(test_long) - 1, PRIME32_1) ==
+	      0xf82ad31fU, "xxh32 63 bytes seeded");
+
+static_assert(""_xxh64 == 0xef46db3751d8e999ULL, "xxh64 empty");
+static_assert("a"_xxh64 == 0xd24ec4f1a98c6e5bULL, "xxh64 1 byte");
+static_assert("abc"_xxh64 == 0x44bc2cf5ad770999ULL, "xxh64 3 bytes");
+static_assert("xxhash-constexpr"_xxh64 == 0x8a964108dee30944ULL,
+	      "xxh64 16 bytes");
+static_assert(xxh64(test_long, sizeof(test_long) - 1, 0) ==
+	      0x7d8c36337a4893fdULL, "xxh64 63 bytes");
+static_assert(xxh64("abc", 3, PRIME32_1) == 0x1318df30094a85fdULL,
+	      "xxh64 seeded");
+static_assert(xxh64(test_long, sizeof(test_long) - 1, PRIME32_1) ==
+	      0xdd86156066df6231ULL, "xxh64 63 bytes seeded");
+
+} /* namespace detail */
+#endif /* XXHASH_HPP_SELFTEST */
+
+} /* namespace xxhash */
+
+#endif /* XXHASH_HPP */
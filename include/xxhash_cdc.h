@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Content-defined chunking cuts a stream where its content says so rather
+ * than every n bytes, so inserting or removing bytes only moves the
+ * boundaries next to the edit and the chunks after it deduplicate again.
+ *
+ * Boundaries come from a gear rolling hash, h = (h << 1) + gear[byte], whose
+ * top bits depend on the last 64 bytes only. A chunk ends after a byte that
+ * leaves the top bits selected by a mask all zero (FastCDC):
+ *
+ * - the first min_size bytes of a chunk are skipped by the rolling hash;
+ * - up to avg_size a mask of log2(avg_size) + level bits is used, past it
+ *   one of log2(avg_size) - level bits, which pulls chunk sizes towards
+ *   avg_size (normalized chunking, level 0 to 3);
+ * - a chunk is cut at max_size regardless.
+ *
+ * Each chunk is also hashed with xxh64() into the xxh64_state of the chunker
+ * right after its bytes were scanned for a boundary, while they are still in
+ * cache, so chunking and fingerprinting are a single pass over the data.
+ */
+
+#ifndef XXHASH_CDC_H
+#define XXHASH_CDC_H
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <xxhash.h>
+#include <fifo.h>
+
+struct xxh_cdc_chunk {
+	uint64_t offset;	/* of the first byte in the stream */
+	size_t length;
+	uint64_t digest;	/* xxh64() of the chunk with the chunker seed */
+};
+
+struct xxh_cdc {
+	size_t min_size;
+	size_t avg_size;
+	size_t max_size;
+	uint64_t mask_s;	/* mask below avg_size, more bits */
+	uint64_t mask_l;	/* mask past avg_size, fewer bits */
+	uint64_t seed;
+	uint64_t gear;		/* rolling hash of the current chunk */
+	size_t length;		/* bytes in the current chunk */
+	uint64_t offset;	/* stream offset of the current chunk */
+	struct xxh64_state state;
+};
+
+/**
+ * xxh_cdc_init() - initialize a chunker at the start of a stream.
+ *
+ * @cdc:      The chunker to initialize.
+ * @min_size: No chunk but the last is shorter.
+ * @avg_size: The targeted chunk size, rounded down to a power of two.
+ * @max_size: No chunk is longer.
+ * @level:    The normalization level, 0 to 3; 2 is a good default.
+ * @seed:     The seed of the chunk digests; boundaries do not depend on it.
+ *
+ * Return:  Zero on success, -EINVAL unless 0 < min_size <= avg_size <=
+ *          max_size and the masks have at least one bit.
+ */
+int xxh_cdc_init(struct xxh_cdc *cdc, size_t min_size, size_t avg_size,
+		 size_t max_size, int level, uint64_t seed);
+
+/**
+ * xxh_cdc_update() - scan input up to the next chunk boundary.
+ *
+ * @cdc:      The chunker.
+ * @input:    The next bytes of the stream.
+ * @length:   The number of bytes in input.
+ * @consumed: Receives the number of bytes of input used.
+ * @chunk:    Receives the chunk that ended, if any.
+ *
+ * Input is used up to and including the last byte of the chunk that ends in
+ * it; the caller passes the rest again to get the following chunks.
+ *
+ * Return:  1 if a chunk ended and was stored in chunk, 0 if all the input was
+ *          used without finding a boundary.
+ */
+int xxh_cdc_update(struct xxh_cdc *cdc, const void *input, size_t length,
+		   size_t *consumed, struct xxh_cdc_chunk *chunk);
+
+/**
+ * xxh_cdc_fifo() - scan the data of a fifo_buffer up to the next boundary.
+ *
+ * @cdc:   The chunker.
+ * @f:     The fifo_buffer to consume from, as its reader.
+ * @chunk: Receives the chunk that ended, if any.
+ *
+ * The data is scanned and hashed in place with fifo_read_acquire() and
+ * released as it is used, so no copy of the stream is made.
+ *
+ * Return:  1 if a chunk ended and was stored in chunk, 0 if the FIFO was
+ *          emptied without finding a boundary.
+ */
+int xxh_cdc_fifo(struct xxh_cdc *cdc, fifo_buffer *f,
+		 struct xxh_cdc_chunk *chunk);
+
+/**
+ * xxh_cdc_finish() - end the stream.
+ *
+ * @cdc:   The chunker; it starts a new stream at offset zero afterwards.
+ * @chunk: Receives the last chunk, if the stream did not end on a boundary.
+ *
+ * Return:  1 if a last chunk was stored in chunk, 0 otherwise.
+ */
+int xxh_cdc_finish(struct xxh_cdc *cdc, struct xxh_cdc_chunk *chunk);
+
+#endif /* XXHASH_CDC_H */
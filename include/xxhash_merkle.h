@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * A Merkle tree over a caller-owned buffer that changes a few blocks at a
+ * time. The buffer is cut into blocks of block_size bytes, the last one
+ * possibly shorter, and each block is a leaf hashed with xxh64(). The leaves
+ * are padded with zero digests to a power of two and every internal node is
+ * xxh64() of the little-endian digests of its two children, seeded with
+ * seed + 1 so that a node never hashes like a 16-byte block.
+ *
+ * Nodes are kept in one array in heap order, node 1 at the top and leaf i at
+ * node nb_slots + i, so the parent of node i is i / 2. After writing to the
+ * buffer the caller marks the written range dirty; xxh_merkle_recompute()
+ * rehashes the dirty leaves and then their ancestors one level at a time,
+ * O(changed blocks * log(blocks)) instead of O(buffer).
+ *
+ * Two trees over buffers of the same length, block size and seed can be
+ * compared with xxh_merkle_diff(), which descends only into subtrees whose
+ * digests differ to find the changed byte ranges.
+ *
+ * Not thread safe; the buffer must not change during xxh_merkle_recompute().
+ */
+
+#ifndef XXHASH_MERKLE_H
+#define XXHASH_MERKLE_H
+
+#include <sys/types.h>
+#include <stdint.h>
+
+struct xxh_merkle {
+	const uint8_t *data;
+	size_t length;
+	size_t block_size;
+	uint64_t seed;
+	size_t nb_leaves;	/* blocks in data */
+	size_t nb_slots;	/* nb_leaves rounded up to a power of two */
+	uint64_t *node;		/* 2 * nb_slots digests, node[0] unused */
+	uint8_t *dirty;		/* per node, set if queued for rehash */
+	size_t *queue;		/* dirty nodes of the level being rehashed */
+	size_t nb_queued;
+};
+
+/**
+ * xxh_merkle_alloc() - build the tree of a buffer.
+ *
+ * @data:       The buffer, referenced until the tree is freed.
+ * @length:     The length of the buffer.
+ * @block_size: The size of a leaf block, nonzero.
+ * @seed:       The seed can be used to alter the result predictably.
+ *
+ * Every block is hashed once here.
+ *
+ * Return:  The tree, or NULL on a zero block size or allocation failure.
+ */
+struct xxh_merkle *xxh_merkle_alloc(const void *data, size_t length,
+				    size_t block_size, uint64_t seed);
+
+/**
+ * xxh_merkle_free() - free a tree, not the buffer.
+ *
+ * @tree: The tree to free, may be NULL.
+ */
+void xxh_merkle_free(struct xxh_merkle *tree);
+
+/**
+ * xxh_merkle_mark_dirty() - note that a range of the buffer was written.
+ *
+ * @tree:   The tree of the buffer.
+ * @offset: The start of the written range.
+ * @length: The length of the written range.
+ *
+ * The blocks overlapping the range are rehashed by the next
+ * xxh_merkle_recompute(). Marking a block twice costs nothing more.
+ *
+ * Return:  Zero on success, -EINVAL if the range is past the buffer.
+ */
+int xxh_merkle_mark_dirty(struct xxh_merkle *tree, size_t offset,
+			  size_t length);
+
+/**
+ * xxh_merkle_recompute() - rehash the dirty blocks and their ancestors.
+ *
+ * @tree: The tree of the buffer.
+ *
+ * Return:  The number of blocks rehashed.
+ */
+size_t xxh_merkle_recompute(struct xxh_merkle *tree);
+
+/**
+ * xxh_merkle_root() - the digest of the whole buffer.
+ *
+ * @tree: The tree of the buffer.
+ *
+ * This is xxh64(), with the seed, of the top node, the length and the block
+ * size as little-endian 64-bit words. It reflects the buffer as of the last
+ * xxh_merkle_recompute().
+ *
+ * Return:  The 64-bit digest of the tree.
+ */
+uint64_t xxh_merkle_root(const struct xxh_merkle *tree);
+
+/**
+ * xxh_merkle_leaf() - the digest of one block.
+ *
+ * @tree:  The tree of the buffer.
+ * @block: The index of the block, below tree->nb_leaves.
+ *
+ * Return:  xxh64() of the block with the tree seed.
+ */
+static inline uint64_t xxh_merkle_leaf(const struct xxh_merkle *tree,
+				       size_t block)
+{
+	return tree->node[tree->nb_slots + block];
+}
+
+/**
+ * xxh_merkle_diff() - find the byte ranges in which two buffers differ.
+ *
+ * @a, @b:  The trees to compare, recomputed, with the same length, block
+ *          size and seed.
+ * @fn:     Called with every maximal run of changed blocks, in increasing
+ *          offset order; a nonzero return stops the walk and is returned.
+ * @opaque: Passed to fn.
+ *
+ * Only subtrees whose top digests differ are visited, so equal trees cost
+ * one comparison.
+ *
+ * Return:  Zero once every range was reported, the nonzero return of fn, or
+ *          -EINVAL if the trees cannot be compared.
+ */
+int xxh_merkle_diff(const struct xxh_merkle *a, const struct xxh_merkle *b,
+		    int (*fn)(size_t offset, size_t length, void *opaque),
+		    void *opaque);
+
+#endif /* XXHASH_MERKLE_H */
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Tree mode splits the input into leaves of leaf_size bytes, the last one
+ * possibly shorter, and hashes them independently with xxh64(). The root is
+ * the xxh64() streaming hash, with the same seed, of the leaf digests in
+ * leaf order as little-endian 64-bit words, followed by the input length
+ * and leaf_size as little-endian 64-bit words:
+ *
+ *   leaf[i] = xxh64(input + i * leaf_size, min(leaf_size, rest), seed)
+ *   root    = xxh64(le64(leaf[0]) .. le64(leaf[n - 1]) le64(length)
+ *                   le64(leaf_size), seed)
+ *
+ * Leaves are hashed by a set of worker threads, but the root only depends
+ * on the input, leaf_size and seed, never on the number of threads or the
+ * order the leaves completed in. The root is not equal to xxh64() of the
+ * input; hashes made with different leaf sizes are unrelated.
+ */
+
+#ifndef XXHASH_TREE_H
+#define XXHASH_TREE_H
+
+#include <sys/types.h>
+#include <stdint.h>
+
+/* Default leaf size, large enough that claiming a leaf costs nothing. */
+#define XXH_TREE_LEAF_SIZE	(1 << 20)
+
+/**
+ * xxh64_tree() - calculate the tree mode 64-bit hash of the input.
+ *
+ * @input:      The data to hash.
+ * @length:     The length of the data to hash.
+ * @leaf_size:  The size of a leaf, 0 for XXH_TREE_LEAF_SIZE.
+ * @seed:       The seed can be used to alter the result predictably.
+ * @nb_threads: The number of threads hashing leaves, the caller included;
+ *              0 or less for one per online CPU.
+ *
+ * Inputs of a single leaf are hashed on the calling thread. If the workers
+ * cannot be started the leaves are hashed on the calling thread, with the
+ * same result.
+ *
+ * Return:  The 64-bit tree hash of the data.
+ */
+uint64_t xxh64_tree(const void *input, size_t length, size_t leaf_size,
+		    uint64_t seed, int nb_threads);
+
+/**
+ * xxh64_tree_fd() - calculate the tree mode 64-bit hash of a file.
+ *
+ * @fd:         The regular file to hash, open for reading.
+ * @leaf_size:  The size of a leaf, 0 for XXH_TREE_LEAF_SIZE.
+ * @seed:       The seed can be used to alter the result predictably.
+ * @nb_threads: As for xxh64_tree().
+ * @hash:       Receives the hash, equal to xxh64_tree() of the contents.
+ *
+ * The file is mapped read-only rather than read, so every worker faults in
+ * the pages of its own leaves and reading scales with the workers.
+ *
+ * Return:  Zero on success, -EINVAL if @fd is not a regular file, otherwise
+ *          a negative errno of fstat() or mmap().
+ */
+int xxh64_tree_fd(int fd, size_t leaf_size, uint64_t seed, int nb_threads,
+		  uint64_t *hash);
+
+#endif /* XXHASH_TREE_H */
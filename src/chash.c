@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Concurrent hash table with lock-free lookups
+ */
+#include <chash.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int chash_init(struct chash *t, unsigned int bits, size_t nb_locks)
+{
+	size_t size, locks = 1;
+	long cpus;
+
+	if (!bits || bits >= 8 * sizeof(size_t))
+		return -EINVAL;
+	size = (size_t)1 << bits;
+	if (!nb_locks) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nb_locks = (cpus > 0 ? cpus : 1) * CHASH_LOCKS_PER_CPU;
+	}
+	while (locks < nb_locks && locks < size)
+		locks <<= 1;
+
+	t->buckets = calloc(size, sizeof(struct hlist_head));
+	if (!t->buckets)
+		return -ENOMEM;
+	if (posix_memalign((void **)&t->locks, sizeof(struct chash_lock),
+			   locks * sizeof(struct chash_lock))) {
+		free(t->buckets);
+		return -ENOMEM;
+	}
+	memset(t->locks, 0, locks * sizeof(struct chash_lock));
+	t->bits = bits;
+	t->lock_mask = locks - 1;
+	return 0;
+}
+
+void chash_destroy(struct chash *t)
+{
+	free(t->buckets);
+	free(t->locks);
+	t->buckets = NULL;
+	t->locks = NULL;
+}
+
+size_t chash_count(const struct chash *t)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i <= t->lock_mask; i++)
+		n += __atomic_load_n(&t->locks[i].nelems, __ATOMIC_RELAXED);
+	return n;
+}
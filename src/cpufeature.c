@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * CPU level detection for runtime kernel selection
+ */
+#include <cpufeature.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_X86	1
+#endif
+
+static const char *const cpu_level_names[] = {
+	[CPU_LEVEL_GENERIC]	= "generic",
+	[CPU_LEVEL_SSE2]	= "sse2",
+	[CPU_LEVEL_SSE42]	= "sse4.2",
+	[CPU_LEVEL_AVX2]	= "avx2",
+	[CPU_LEVEL_AVX512]	= "avx512",
+};
+
+/* -1 until detected; racing first callers store the same value */
+static int cpu_level_cached = -1;
+static int cpu_level_hw = -1;
+
+#ifdef CPU_X86
+#define XCR0_SSE	(1 << 1)
+#define XCR0_AVX	(1 << 2)
+#define XCR0_AVX512	(7 << 5)	/* opmask, ZMM0-15 upper, ZMM16-31 */
+
+static unsigned long long cpu_xgetbv(void)
+{
+	unsigned int eax, edx;
+
+	__asm__ volatile("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return (unsigned long long)edx << 32 | eax;
+}
+
+static int cpu_detect(void)
+{
+	unsigned int eax, ebx, ecx, edx, eax7, ebx7 = 0, ecx7, edx7;
+	unsigned long long xcr0 = 0;
+	int level = CPU_LEVEL_GENERIC;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return level;
+	if (__get_cpuid_max(0, NULL) >= 7)
+		__cpuid_count(7, 0, eax7, ebx7, ecx7, edx7);
+	if (ecx & bit_OSXSAVE)
+		xcr0 = cpu_xgetbv();
+
+	if (!(edx & bit_SSE) || !(edx & bit_SSE2))
+		return level;
+	level = CPU_LEVEL_SSE2;
+
+	if (!(ecx & bit_SSE3) || !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1) ||
+	    !(ecx & bit_SSE4_2) || !(ecx & bit_POPCNT))
+		return level;
+	level = CPU_LEVEL_SSE42;
+
+	if (!(ecx & bit_AVX) || !(ecx & bit_FMA) || !(ebx7 & bit_AVX2) ||
+	    !(ebx7 & bit_BMI) || !(ebx7 & bit_BMI2) ||
+	    (xcr0 & (XCR0_SSE | XCR0_AVX)) != (XCR0_SSE | XCR0_AVX))
+		return level;
+	level = CPU_LEVEL_AVX2;
+
+	if (!(ebx7 & bit_AVX512F) || !(ebx7 & bit_AVX512BW) ||
+	    !(ebx7 & bit_AVX512CD) || !(ebx7 & bit_AVX512DQ) ||
+	    !(ebx7 & bit_AVX512VL) || (xcr0 & XCR0_AVX512) != XCR0_AVX512)
+		return level;
+	return CPU_LEVEL_AVX512;
+}
+#else
+static int cpu_detect(void)
+{
+	return CPU_LEVEL_GENERIC;
+}
+#endif /* CPU_X86 */
+
+static int cpu_level_parse(const char *s)
+{
+	int level;
+
+	if (!strncmp(s, "x86-64-v", 8) && s[8] >= '1' && s[8] <= '4' && !s[9])
+		return CPU_LEVEL_SSE2 + s[8] - '1';
+	for (level = 0; level <= CPU_LEVEL_MAX; level++)
+		if (!strcmp(s, cpu_level_names[level]))
+			return level;
+	return -1;
+}
+
+int cpu_level_detected(void)
+{
+	int level = __atomic_load_n(&cpu_level_hw, __ATOMIC_RELAXED);
+
+	if (unlikely(level < 0)) {
+		level = cpu_detect();
+		__atomic_store_n(&cpu_level_hw, level, __ATOMIC_RELAXED);
+	}
+	return level;
+}
+
+int cpu_level(void)
+{
+	int level = __atomic_load_n(&cpu_level_cached, __ATOMIC_RELAXED);
+	const char *env;
+	int cap;
+
+	if (likely(level >= 0))
+		return level;
+
+	level = cpu_level_detected();
+	env = getenv(CPU_LEVEL_ENV);
+	if (env && (cap = cpu_level_parse(env)) >= 0 && cap < level)
+		level = cap;
+	__atomic_store_n(&cpu_level_cached, level, __ATOMIC_RELAXED);
+	return level;
+}
+
+const char *cpu_level_name(int level)
+{
+	if (level < 0 || level > CPU_LEVEL_MAX)
+		return "unknown";
+	return cpu_level_names[level];
+}
+
+/* Settle the level, and read the environment, before any kernel is picked. */
+__attribute__((constructor))
+static void cpu_level_init(void)
+{
+	cpu_level();
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Epoch based reclamation
+ */
+#include <ebr.h>
+#include <errno.h>
+#include <sched.h>
+
+#define EBR_SPIN	128	/* polls of a reader before yielding */
+
+int ebr_init(struct ebr *d, size_t batch)
+{
+	int ret = pthread_mutex_init(&d->lock, NULL);
+
+	if (ret)
+		return -ret;
+	/* 0 means outside a section, the epochs start at 1 */
+	d->epoch = 1;
+	INIT_LIST_HEAD(&d->threads);
+	d->pending = NULL;
+	d->nb_pending = 0;
+	d->batch = batch ? batch : EBR_BATCH;
+	return 0;
+}
+
+void ebr_destroy(struct ebr *d)
+{
+	ebr_barrier(d);
+	pthread_mutex_destroy(&d->lock);
+}
+
+void ebr_thread_register(struct ebr *d, struct ebr_thread *t)
+{
+	t->epoch = 0;
+	t->nesting = 0;
+	pthread_mutex_lock(&d->lock);
+	list_add(&t->list, &d->threads);
+	pthread_mutex_unlock(&d->lock);
+}
+
+void ebr_thread_unregister(struct ebr *d, struct ebr_thread *t)
+{
+	pthread_mutex_lock(&d->lock);
+	list_del(&t->list);
+	pthread_mutex_unlock(&d->lock);
+}
+
+/*
+ * A reader that loaded the old epoch but stores it only after the scan
+ * below passed it is not waited for. That is fine: its store is followed
+ * by a full barrier, and so is the store of the new epoch, so its reads
+ * come after everything the writer unlinked before calling us. Epochs are
+ * 64-bit and never wrap, so such a stale epoch only makes the next grace
+ * period wait for that section too.
+ */
+void ebr_synchronize(struct ebr *d)
+{
+	struct list_head *pos;
+	struct ebr_thread *t;
+	uint64_t epoch, e;
+	int spin;
+
+	pthread_mutex_lock(&d->lock);
+	epoch = d->epoch + 1;
+	__atomic_store_n(&d->epoch, epoch, __ATOMIC_RELAXED);
+	smp_mb();
+	list_for_each(pos, &d->threads) {
+		t = (struct ebr_thread *)pos;
+		for (spin = 0; (e = smp_load_acquire(&t->epoch)) && e < epoch;
+		     spin++) {
+			if (spin < EBR_SPIN)
+				cpu_relax();
+			else
+				sched_yield();
+		}
+	}
+	pthread_mutex_unlock(&d->lock);
+}
+
+void ebr_barrier(struct ebr *d)
+{
+	struct ebr_head *head, *next;
+	size_t nb = 0;
+
+	head = __atomic_exchange_n(&d->pending, NULL, __ATOMIC_ACQUIRE);
+	if (!head)
+		return;
+	for (next = head; next; next = next->next)
+		nb++;
+	__atomic_fetch_sub(&d->nb_pending, nb, __ATOMIC_RELAXED);
+
+	ebr_synchronize(d);
+	for (; head; head = next) {
+		next = head->next;
+		head->func(head);
+	}
+}
+
+void ebr_call(struct ebr *d, struct ebr_head *head,
+	      void (*func)(struct ebr_head *head))
+{
+	head->func = func;
+	head->next = __atomic_load_n(&d->pending, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&d->pending, &head->next, head, true,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	if (__atomic_add_fetch(&d->nb_pending, 1, __ATOMIC_RELAXED) >= d->batch)
+		ebr_barrier(d);
+}
@@ -20,48 +20,389 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE
 #include <fifo.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <compiler.h>
 
-static fifo_buffer *fifo_alloc_common(void *buffer, size_t size)
+/*
+ * Map [0, off + size) of fd, followed by [off, off + size) once more, so
+ * that the byte at base + off + size + i is the byte at base + off + i and
+ * any window of up to size bytes from base + off on is contiguous.
+ * With mirror unset only the first view is mapped.
+ */
+static uint8_t *fifo_map(int fd, size_t off, size_t size, int mirror)
 {
-    fifo_buffer *f;
+    size_t total = off + (mirror ? 2 : 1) * size;
+    uint8_t *base;
+
+    /* reserve the whole range first so nobody can map into the gap */
+    base = mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    if (mmap(base, off + size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        (mirror && mmap(base + off + size, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED, fd, off) == MAP_FAILED)) {
+        munmap(base, total);
+        return NULL;
+    }
+    return base;
+}
+
+static uint8_t *fifo_map_mirrored(int fd, size_t size)
+{
+    if (ftruncate(fd, size) < 0)
+        return NULL;
+    return fifo_map(fd, 0, size, 1);
+}
+
+/* Round a requested size up to what the buffer mode needs, 0 if impossible. */
+static size_t fifo_round_size(size_t size, int flags)
+{
+    if (flags & FIFO_FLAG_POW2) {
+        /* the slot of an index is ndx & mask only if the size divides 2^64 */
+        if (size > 1UL << 63)
+            return 0;
+        if (size > 1)
+            size = 1UL << (64 - __clzl(size - 1));
+    }
+    if (flags & FIFO_FLAG_MIRRORED) {
+        size_t page = sysconf(_SC_PAGESIZE);
+
+        /* page rounding keeps a power of two a power of two */
+        size = (size + page - 1) & ~(page - 1);
+    }
+    return size;
+}
+
+/* Point f at storage of size bytes; data is kept as an offset from f. */
+static void fifo_set_buffer(fifo_buffer *f, uint8_t *buffer, size_t size)
+{
+    f->data = buffer - (uint8_t *)f;
+    f->size = size;
+    f->mask = f->flags & FIFO_FLAG_POW2 ? size - 1 : 0;
+}
+
+static int fifo_alloc_buffer(fifo_buffer *f, size_t size, int flags)
+{
+    uint8_t *buffer;
+
+    f->flags = flags;
+    f->fd    = -1;
+    size = fifo_round_size(size, flags);
+    if (!size && flags)
+        return EINVAL;
+    if (flags & FIFO_FLAG_MIRRORED) {
+        f->fd = memfd_create("fifo", MFD_CLOEXEC);
+        if (f->fd < 0)
+            return ENOMEM;
+        buffer = fifo_map_mirrored(f->fd, size);
+        if (!buffer)
+            close(f->fd);
+    } else {
+        buffer = malloc(size);
+    }
     if (!buffer)
+        return ENOMEM;
+    fifo_set_buffer(f, buffer, size);
+    return 0;
+}
+
+static void fifo_free_buffer(fifo_buffer *f)
+{
+    if (f->flags & FIFO_FLAG_MIRRORED) {
+        munmap(fifo_data(f), 2 * f->size);
+        close(f->fd);
+    } else {
+        free(fifo_data(f));
+    }
+    f->data = 0;
+}
+
+/*
+ * Number of bytes addressable linearly from position pos: up to the end
+ * of the buffer, or one more lap on a mirrored ring.
+ */
+static inline size_t fifo_contig(const fifo_buffer *f, size_t pos)
+{
+    size_t len = f->size - pos;
+    if (f->flags & FIFO_FLAG_MIRRORED)
+        len += f->size;
+    return len;
+}
+
+/*
+ * Move position pos forward by size bytes; ndx is the index it ends up at,
+ * which on a power-of-two buffer gives the slot directly.
+ */
+static inline size_t fifo_advance(const fifo_buffer *f, size_t pos,
+                                  uint64_t ndx, size_t size)
+{
+    if (f->mask)
+        return ndx & f->mask;
+    pos += size;
+    if (pos >= f->size)
+        pos -= f->size;
+    return pos;
+}
+
+/*
+ * Blocking support.
+ * A side that has to wait records the futex value it will sleep on and the
+ * threshold it waits for, then issues a full barrier and rechecks. The
+ * other side publishes its index, issues a full barrier and reads the
+ * threshold, so either the waiter sees the new index or the publisher sees
+ * the waiter. Only the publisher modifies the futex word it bumps, and
+ * only once per recorded value, so a burst of updates costs one wake.
+ * The futexes of a shared FIFO live in shared memory and must not be
+ * private to the process.
+ */
+#define FIFO_SPIN_MIN   16
+#define FIFO_SPIN_MAX   4096
+
+static inline int fifo_futex_flags(const fifo_buffer *f)
+{
+    return f->flags & FIFO_FLAG_SHARED ? 0 : FUTEX_PRIVATE_FLAG;
+}
+
+static int fifo_futex_wait(const fifo_buffer *f, uint32_t *uaddr, uint32_t val,
+                           const struct timespec *deadline)
+{
+    /* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline */
+    if (syscall(SYS_futex, uaddr, FUTEX_WAIT_BITSET | fifo_futex_flags(f),
+                val, deadline, NULL, FUTEX_BITSET_MATCH_ANY) < 0 &&
+        errno == ETIMEDOUT)
+        return -ETIMEDOUT;
+    return 0;
+}
+
+static void fifo_futex_wake(const fifo_buffer *f, uint32_t *uaddr)
+{
+    syscall(SYS_futex, uaddr, FUTEX_WAKE | fifo_futex_flags(f), 1, NULL, NULL, 0);
+}
+
+static void fifo_wake(fifo_buffer *f, size_t (*avail)(const fifo_buffer *),
+                      size_t *want, uint32_t *seq, uint32_t *futex)
+{
+    size_t need;
+
+    smp_mb();
+    need = smp_load_acquire(want);
+    if (!need || READ_ONCE(*seq) != *futex || avail(f) < need)
+        return;
+    smp_store_release(futex, *futex + 1);
+    fifo_futex_wake(f, futex);
+}
+
+static int fifo_wait(fifo_buffer *f, size_t (*avail)(const fifo_buffer *),
+                     size_t need, size_t *want, uint32_t *seq,
+                     uint32_t *futex, int *spin, int timeout)
+{
+    struct timespec deadline;
+    int i, ret = 0;
+
+    if (!(f->flags & FIFO_FLAG_BLOCKING) || need > f->size)
+        return -EINVAL;
+    if (avail(f) >= need)
+        return 0;
+
+    for (i = 0; i < *spin; i++) {
+        cpu_relax();
+        if (avail(f) >= need) {
+            *spin = min(*spin * 2, FIFO_SPIN_MAX);
+            return 0;
+        }
+    }
+    *spin = max(*spin / 2, FIFO_SPIN_MIN);
+    if (!timeout)
+        return -ETIMEDOUT;
+
+    if (timeout > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec  += timeout / 1000;
+        deadline.tv_nsec += timeout % 1000 * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    for (;;) {
+        uint32_t val = smp_load_acquire(futex);
+
+        WRITE_ONCE(*seq, val);
+        smp_store_release(want, need);
+        smp_mb();
+        if (avail(f) >= need)
+            break;
+        if (fifo_futex_wait(f, futex, val, timeout > 0 ? &deadline : NULL)) {
+            if (avail(f) < need)
+                ret = -ETIMEDOUT;
+            break;
+        }
+    }
+    smp_store_release(want, 0);
+    return ret;
+}
+
+/* make the data visible before the consumer can see the new index */
+static inline void fifo_publish_wndx(fifo_buffer *f, uint64_t wndx)
+{
+    smp_store_release(&f->wndx, wndx);
+    if (unlikely(f->flags & FIFO_FLAG_BLOCKING))
+        fifo_wake(f, fifo_size64, &f->read_want, &f->read_seq, &f->data_seq);
+}
+
+/* the bytes must be consumed before the producer may reuse them */
+static inline void fifo_publish_rndx(fifo_buffer *f, uint64_t rndx)
+{
+    smp_store_release(&f->rndx, rndx);
+    if (unlikely(f->flags & FIFO_FLAG_BLOCKING))
+        fifo_wake(f, fifo_space64, &f->write_want, &f->write_seq, &f->space_seq);
+}
+
+int fifo_read_wait(fifo_buffer *f, size_t min_bytes, int timeout)
+{
+    return fifo_wait(f, fifo_size64, min_bytes, &f->read_want, &f->read_seq,
+                     &f->data_seq, &f->read_spin, timeout);
+}
+
+int fifo_write_wait(fifo_buffer *f, size_t min_space, int timeout)
+{
+    return fifo_wait(f, fifo_space64, min_space, &f->write_want, &f->write_seq,
+                     &f->space_seq, &f->write_spin, timeout);
+}
+
+static fifo_buffer *fifo_alloc_common(size_t size, int flags)
+{
+    fifo_buffer *f;
+    if (posix_memalign((void **)&f, L1_CACHE_BYTES, sizeof(fifo_buffer)))
         return NULL;
-    f = malloc(sizeof(fifo_buffer));
-    if (!f) {
-        free(buffer);
+    memset(f, 0, sizeof(*f));
+    f->read_spin = f->write_spin = FIFO_SPIN_MIN;
+    if (fifo_alloc_buffer(f, size, flags)) {
+        free(f);
         return NULL;
     }
-    f->buffer = buffer;
-    f->end    = f->buffer + size;
     fifo_reset(f);
     return f;
 }
 
 fifo_buffer *fifo_alloc(unsigned int size)
 {
-    void *buffer = malloc(size);
-    return fifo_alloc_common(buffer, size);
+    return fifo_alloc_common(size, 0);
+}
+
+fifo_buffer *fifo_alloc64(size_t size)
+{
+    return fifo_alloc_common(size, 0);
 }
 
 fifo_buffer *fifo_alloc_array(size_t nmemb, size_t size)
 {
-    void *buffer = malloc(nmemb * size);
-    return fifo_alloc_common(buffer, nmemb * size);
+    if (size && nmemb > SIZE_MAX / size)
+        return NULL;
+    return fifo_alloc_common(nmemb * size, 0);
+}
+
+fifo_buffer *fifo_alloc2(size_t size, int flags)
+{
+    return fifo_alloc_common(size, flags);
+}
+
+fifo_buffer *fifo_alloc_mirrored(size_t size)
+{
+    return fifo_alloc_common(size, FIFO_FLAG_MIRRORED);
+}
+
+/*
+ * Shared FIFOs.
+ * The fd holds the fifo_buffer itself on the first page(s), the data
+ * follows at offset f->data. Every field is either an index, a position or
+ * an offset relative to f, so each process may map it at its own address.
+ */
+#define FIFO_MAGIC      0x4f464946  /* "FIFO" */
+
+static size_t fifo_header_size(void)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (sizeof(fifo_buffer) + page - 1) & ~(page - 1);
+}
+
+static fifo_buffer *fifo_map_shared(int fd, size_t hdr, size_t size, int flags)
+{
+    return (fifo_buffer *)fifo_map(fd, hdr, size, flags & FIFO_FLAG_MIRRORED);
+}
+
+fifo_buffer *fifo_alloc_shared(int fd, size_t size, int flags)
+{
+    size_t hdr = fifo_header_size();
+    fifo_buffer *f;
+
+    flags |= FIFO_FLAG_SHARED;
+    size = fifo_round_size(size, flags);
+    if (!size || size > SIZE_MAX / 2 - hdr) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (ftruncate(fd, hdr + size) < 0)
+        return NULL;
+    f = fifo_map_shared(fd, hdr, size, flags);
+    if (!f)
+        return NULL;
+
+    memset(f, 0, sizeof(*f));
+    f->flags = flags;
+    f->fd    = -1;
+    f->read_spin = f->write_spin = FIFO_SPIN_MIN;
+    fifo_set_buffer(f, (uint8_t *)f + hdr, size);
+    fifo_reset(f);
+    /* an attaching process must not see the magic before the header */
+    smp_store_release(&f->magic, FIFO_MAGIC);
+    return f;
+}
+
+fifo_buffer *fifo_attach_shared(int fd)
+{
+    fifo_buffer hdr;
+    struct stat st;
+
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || fstat(fd, &st) < 0)
+        return NULL;
+    if (hdr.magic != FIFO_MAGIC || !(hdr.flags & FIFO_FLAG_SHARED) ||
+        hdr.data < (ssize_t)sizeof(hdr) || !hdr.size ||
+        hdr.size > SIZE_MAX / 2 - hdr.data ||
+        (size_t)st.st_size < hdr.data + hdr.size) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return fifo_map_shared(fd, hdr.data, hdr.size, hdr.flags);
 }
 
 void fifo_free(fifo_buffer *f)
 {
-    if (f) {
-        free(f->buffer);
-        f->buffer = NULL;
-        free(f);
+    if (!f)
+        return;
+    if (f->flags & FIFO_FLAG_SHARED) {
+        /* the fd belongs to the caller, only this mapping goes away */
+        size_t size = f->size;
+        munmap(f, f->data + (f->flags & FIFO_FLAG_MIRRORED ? 2 : 1) * size);
+        return;
     }
+    fifo_free_buffer(f);
+    free(f);
 }
 
 void fifo_freep(fifo_buffer **f)
@@ -74,117 +415,410 @@ void fifo_freep(fifo_buffer **f)
 
 void fifo_reset(fifo_buffer *f)
 {
-    f->wptr = f->rptr = f->buffer;
+    f->wpos = f->rpos = 0;
     f->wndx = f->rndx = 0;
 }
 
+size_t fifo_size64(const fifo_buffer *f)
+{
+    return smp_load_acquire(&f->wndx) - smp_load_acquire(&f->rndx);
+}
+
+size_t fifo_space64(const fifo_buffer *f)
+{
+    return f->size - fifo_size64(f);
+}
+
 int fifo_size(const fifo_buffer *f)
 {
-    return (uint32_t)(f->wndx - f->rndx);
+    return min(fifo_size64(f), (size_t)INT_MAX);
 }
 
 int fifo_space(const fifo_buffer *f)
 {
-    return f->end - f->buffer - fifo_size(f);
+    return min(fifo_space64(f), (size_t)INT_MAX);
+}
+
+/*
+ * Grow the storage of f to new_size bytes keeping the bytes in place, then
+ * make the live data contiguous modulo the new size again. If it wrapped,
+ * either the head [0, wpos) is appended after the old end or the tail
+ * [rpos, old end) is moved to the new end, whichever moves fewer bytes.
+ */
+static int fifo_grow_in_place(fifo_buffer *f, size_t new_size)
+{
+    size_t old_size = f->size;
+    size_t rpos     = f->rpos;
+    size_t len      = fifo_size64(f);
+    size_t wpos     = rpos + len;
+    uint8_t *buffer;
+
+    if (f->flags & FIFO_FLAG_SHARED)
+        return EINVAL;
+    if (f->flags & FIFO_FLAG_MIRRORED) {
+        /* the memfd keeps its pages, only the two views are rebuilt */
+        buffer = fifo_map_mirrored(f->fd, new_size);
+        if (!buffer)
+            return ENOMEM;
+        munmap(fifo_data(f), 2 * old_size);
+    } else {
+        /* large blocks are moved with mremap() by realloc(), not copied */
+        buffer = realloc(fifo_data(f), new_size);
+        if (!buffer)
+            return ENOMEM;
+    }
+
+    if (wpos > old_size) {
+        size_t tail = old_size - rpos, head = len - tail;
+
+        if (head <= new_size - old_size && head <= tail) {
+            memcpy(buffer + old_size, buffer, head);
+            wpos = old_size + head;
+        } else {
+            memmove(buffer + new_size - tail, buffer + rpos, tail);
+            rpos = new_size - tail;
+            wpos = head;
+        }
+    }
+    if (wpos == new_size)
+        wpos = 0;
+
+    fifo_set_buffer(f, buffer, new_size);
+    f->rpos = rpos;
+    f->wpos = wpos;
+    if (f->flags & FIFO_FLAG_POW2) {
+        /* positions moved, so rebase the indices onto them */
+        f->rndx = rpos;
+        f->wndx = rpos + len;
+    }
+    return 0;
 }
 
 int fifo_realloc2(fifo_buffer *f, unsigned int new_size)
 {
-    unsigned int old_size = f->end - f->buffer;
+    return fifo_realloc64(f, new_size);
+}
+
+int fifo_realloc64(fifo_buffer *f, size_t new_size)
+{
+    size_t old_size = f->size;
 
     if (old_size < new_size) {
-        int len          = fifo_size(f);
-        fifo_buffer *f2 = fifo_alloc(new_size);
+        size_t size = fifo_round_size(new_size, f->flags);
 
-        if (!f2)
-            return ENOMEM;
-        fifo_generic_read(f, f2->buffer, len, NULL);
-        f2->wptr += len;
-        f2->wndx += len;
-        free(f->buffer);
-        *f = *f2;
-        free(f2);
+        if (!size)
+            return EINVAL;
+        return fifo_grow_in_place(f, size);
     }
     return 0;
 }
 
 int fifo_grow(fifo_buffer *f, unsigned int size)
 {
-    unsigned int old_size = f->end - f->buffer;
-    if(size + (unsigned)fifo_size(f) < size)
+    return fifo_grow64(f, size);
+}
+
+int fifo_grow64(fifo_buffer *f, size_t size)
+{
+    size_t old_size = f->size;
+    if(size + fifo_size64(f) < size)
         return EINVAL;
 
-    size += fifo_size(f);
+    size += fifo_size64(f);
 
     if (old_size < size)
-        return fifo_realloc2(f, max(size, 2*old_size));
+        return fifo_realloc64(f, max(size, 2*old_size));
     return 0;
 }
 
+/*
+ * The int API keeps its callback types; these adapt them to the size_t
+ * callbacks of the 64-bit API. Chunks never exceed the int request size.
+ */
+struct fifo_cb {
+    void *opaque;
+    union {
+        int  (*write)(void *, void *, int);
+        void (*read)(void *, void *, int);
+    };
+};
+
+static ssize_t fifo_write_cb(void *opaque, void *buf, size_t len)
+{
+    struct fifo_cb *cb = opaque;
+    return cb->write(cb->opaque, buf, len);
+}
+
+static void fifo_read_cb(void *opaque, void *buf, size_t len)
+{
+    struct fifo_cb *cb = opaque;
+    cb->read(cb->opaque, buf, len);
+}
+
 /* src must NOT be const as it can be a context for func that may need
  * updating (like a pointer or byte counter) */
 int fifo_generic_write(fifo_buffer *f, void *src, int size,
                           int (*func)(void *, void *, int))
 {
-    int total = size;
-    uint32_t wndx= f->wndx;
-    uint8_t *wptr= f->wptr;
+    struct fifo_cb cb = { .opaque = src, .write = func };
+
+    if (func)
+        return fifo_generic_write64(f, &cb, size, fifo_write_cb);
+    return fifo_generic_write64(f, src, size, NULL);
+}
+
+size_t fifo_generic_write64(fifo_buffer *f, void *src, size_t size,
+                            ssize_t (*func)(void *, void *, size_t))
+{
+    size_t total = size;
+    uint64_t wndx= f->wndx;
+    size_t wpos  = f->wpos;
+    uint8_t *buffer = fifo_data(f);
 
     do {
-        int len = min(f->end - wptr, size);
+        ssize_t len = min(fifo_contig(f, wpos), size);
         if (func) {
-            len = func(src, wptr, len);
+            len = func(src, buffer + wpos, len);
             if (len <= 0)
                 break;
         } else {
-            memcpy(wptr, src, len);
+            memcpy(buffer + wpos, src, len);
             src = (uint8_t *)src + len;
         }
-// Write memory barrier needed for SMP here in theory
-        wptr += len;
-        if (wptr >= f->end)
-            wptr = f->buffer;
         wndx    += len;
+        wpos     = fifo_advance(f, wpos, wndx, len);
         size    -= len;
     } while (size > 0);
-    f->wndx= wndx;
-    f->wptr= wptr;
+    f->wpos= wpos;
+    fifo_publish_wndx(f, wndx);
     return total - size;
 }
 
+static int fifo_spans(const fifo_buffer *f, size_t pos, int size,
+                      uint8_t *ptr[2], int len[2])
+{
+    ptr[0] = fifo_data(f) + pos;
+    len[0] = min(fifo_contig(f, pos), (size_t)size);
+    ptr[1] = fifo_data(f);
+    len[1] = size - len[0];
+    return size;
+}
+
+int fifo_write_reserve(fifo_buffer *f, int want, uint8_t *ptr[2], int len[2])
+{
+    assert(want >= 0);
+    return fifo_spans(f, f->wpos, min(want, fifo_space(f)), ptr, len);
+}
+
+void fifo_write_commit(fifo_buffer *f, int size)
+{
+    uint64_t wndx = f->wndx + size;
+
+    assert(fifo_space(f) >= size);
+    f->wpos = fifo_advance(f, f->wpos, wndx, size);
+    fifo_publish_wndx(f, wndx);
+}
+
+int fifo_read_acquire(fifo_buffer *f, int want, uint8_t *ptr[2], int len[2])
+{
+    assert(want >= 0);
+    return fifo_spans(f, f->rpos, min(want, fifo_size(f)), ptr, len);
+}
+
+void fifo_read_release(fifo_buffer *f, int size)
+{
+    fifo_drain(f, size);
+}
+
+static int fifo_iov(struct iovec iov[2], uint8_t *ptr[2], int len[2])
+{
+    iov[0].iov_base = ptr[0];
+    iov[0].iov_len  = len[0];
+    iov[1].iov_base = ptr[1];
+    iov[1].iov_len  = len[1];
+    return len[1] ? 2 : 1;
+}
+
+int fifo_fill_from_fd(fifo_buffer *f, int fd, int max)
+{
+    struct iovec iov[2];
+    uint8_t *ptr[2];
+    int len[2], cnt;
+    ssize_t ret;
+
+    if (max <= 0)
+        return 0;
+    if (!fifo_write_reserve(f, max, ptr, len))
+        return -ENOSPC;
+    cnt = fifo_iov(iov, ptr, len);
+    do {
+        ret = readv(fd, iov, cnt);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return errno == EWOULDBLOCK ? -EAGAIN : -errno;
+    fifo_write_commit(f, ret);
+    return ret;
+}
+
+int fifo_drain_to_fd(fifo_buffer *f, int fd, int max)
+{
+    struct iovec iov[2];
+    uint8_t *ptr[2];
+    int len[2], cnt;
+    ssize_t ret;
+
+    if (!fifo_read_acquire(f, max, ptr, len))
+        return 0;
+    cnt = fifo_iov(iov, ptr, len);
+    do {
+        ret = writev(fd, iov, cnt);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return errno == EWOULDBLOCK ? -EAGAIN : -errno;
+    fifo_read_release(f, ret);
+    return ret;
+}
+
+/* Describe bytes [off, off + size) of the region given by ptr/len. */
+static void fifo_subspan(uint8_t *ptr[2], int len[2], int off, int size,
+                         fifo_msg *out)
+{
+    if (off < len[0]) {
+        out->ptr[0] = ptr[0] + off;
+        out->len[0] = min(len[0] - off, size);
+        out->ptr[1] = ptr[1];
+        out->len[1] = size - out->len[0];
+    } else {
+        out->ptr[0] = ptr[1] + off - len[0];
+        out->len[0] = size;
+        out->ptr[1] = NULL;
+        out->len[1] = 0;
+    }
+}
+
+static void fifo_msg_put(uint8_t *ptr[2], int len[2], int off,
+                         const void *src, int size)
+{
+    fifo_msg m;
+
+    fifo_subspan(ptr, len, off, size, &m);
+    memcpy(m.ptr[0], src, m.len[0]);
+    memcpy(m.ptr[1], (const uint8_t *)src + m.len[0], m.len[1]);
+}
+
+static void fifo_msg_get(const fifo_msg *m, void *dest)
+{
+    memcpy(dest, m->ptr[0], m->len[0]);
+    memcpy((uint8_t *)dest + m->len[0], m->ptr[1], m->len[1]);
+}
+
+int fifo_msg_push(fifo_buffer *f, const void *msg, int size)
+{
+    uint32_t hdr = size;
+    uint8_t *ptr[2];
+    int len[2];
+
+    assert(size >= 0);
+    if (size > INT_MAX - (int)sizeof(hdr) || fifo_space(f) < (int)sizeof(hdr) + size)
+        return -ENOSPC;
+    fifo_write_reserve(f, sizeof(hdr) + size, ptr, len);
+    fifo_msg_put(ptr, len, 0, &hdr, sizeof(hdr));
+    fifo_msg_put(ptr, len, sizeof(hdr), msg, size);
+    fifo_write_commit(f, sizeof(hdr) + size);
+    return 0;
+}
+
+int fifo_msg_peek_batch(fifo_buffer *f, fifo_msg *msgs, int nb, int *bytes)
+{
+    uint8_t *ptr[2];
+    int len[2], avail, off = 0, n = 0;
+
+    avail = fifo_read_acquire(f, INT_MAX, ptr, len);
+    while (n < nb && avail - off >= (int)sizeof(uint32_t)) {
+        uint32_t hdr;
+        fifo_msg m;
+
+        fifo_subspan(ptr, len, off, sizeof(hdr), &m);
+        fifo_msg_get(&m, &hdr);
+        if (hdr > (uint32_t)(avail - off) - sizeof(hdr))
+            break;
+        fifo_subspan(ptr, len, off + sizeof(hdr), hdr, &msgs[n++]);
+        off += sizeof(hdr) + hdr;
+    }
+    *bytes = off;
+    return n;
+}
+
+int fifo_msg_peek(fifo_buffer *f, fifo_msg *msg)
+{
+    int bytes;
+
+    if (!fifo_msg_peek_batch(f, msg, 1, &bytes))
+        return -EAGAIN;
+    return msg->len[0] + msg->len[1];
+}
+
+int fifo_msg_pop(fifo_buffer *f, void *dest, int size)
+{
+    fifo_msg m;
+    int ret = fifo_msg_peek(f, &m);
+
+    if (ret < 0)
+        return ret;
+    if (dest) {
+        if (ret > size)
+            return -ENOBUFS;
+        fifo_msg_get(&m, dest);
+    }
+    fifo_drain(f, sizeof(uint32_t) + ret);
+    return ret;
+}
+
 int fifo_generic_peek_at(fifo_buffer *f, void *dest, int offset, int buf_size, void (*func)(void*, void*, int))
 {
-    uint8_t *rptr = f->rptr;
+    struct fifo_cb cb = { .opaque = dest, .read = func };
 
     assert(offset >= 0);
+    if (func)
+        return fifo_generic_peek_at64(f, &cb, offset, buf_size, fifo_read_cb);
+    return fifo_generic_peek_at64(f, dest, offset, buf_size, NULL);
+}
+
+int fifo_generic_peek_at64(fifo_buffer *f, void *dest, size_t offset, size_t buf_size,
+                           void (*func)(void*, void*, size_t))
+{
+    uint8_t *buffer = fifo_data(f);
+    size_t rpos     = f->rpos;
 
     /*
-     * *ndx are indexes modulo 2^32, they are intended to overflow,
-     * to handle *ndx greater than 4gb.
+     * *ndx are free-running 64-bit indexes, their difference is the
+     * amount of data even when they overflow.
      */
-    assert(buf_size + (unsigned)offset <= f->wndx - f->rndx);
+    assert(buf_size + offset <= fifo_size64(f));
 
-    if (offset >= f->end - rptr)
-        rptr += offset - (f->end - f->buffer);
+    if (f->mask)
+        rpos = (f->rndx + offset) & f->mask;
+    else if (offset >= f->size - rpos)
+        rpos += offset - f->size;
     else
-        rptr += offset;
+        rpos += offset;
 
     while (buf_size > 0) {
-        int len;
+        size_t len;
 
-        if (rptr >= f->end)
-            rptr -= f->end - f->buffer;
+        if (rpos >= f->size)
+            rpos -= f->size;
 
-        len = min(f->end - rptr, buf_size);
+        len = min(fifo_contig(f, rpos), buf_size);
         if (func)
-            func(dest, rptr, len);
+            func(dest, buffer + rpos, len);
         else {
-            memcpy(dest, rptr, len);
+            memcpy(dest, buffer + rpos, len);
             dest = (uint8_t *)dest + len;
         }
 
         buf_size -= len;
-        rptr     += len;
+        rpos     += len;
     }
 
     return 0;
@@ -193,52 +827,49 @@ int fifo_generic_peek_at(fifo_buffer *f, void *dest, int offset, int buf_size, v
 int fifo_generic_peek(fifo_buffer *f, void *dest, int buf_size,
                          void (*func)(void *, void *, int))
 {
-// Read memory barrier needed for SMP here in theory
-    uint8_t *rptr = f->rptr;
-
-    do {
-        int len = min(f->end - rptr, buf_size);
-        if (func)
-            func(dest, rptr, len);
-        else {
-            memcpy(dest, rptr, len);
-            dest = (uint8_t *)dest + len;
-        }
-// memory barrier needed for SMP here in theory
-        rptr += len;
-        if (rptr >= f->end)
-            rptr -= f->end - f->buffer;
-        buf_size -= len;
-    } while (buf_size > 0);
-
-    return 0;
+    return fifo_generic_peek_at(f, dest, 0, buf_size, func);
 }
 
 int fifo_generic_read(fifo_buffer *f, void *dest, int buf_size,
                          void (*func)(void *, void *, int))
 {
-// Read memory barrier needed for SMP here in theory
-    do {
-        int len = min(f->end - f->rptr, buf_size);
+    struct fifo_cb cb = { .opaque = dest, .read = func };
+
+    if (func)
+        return fifo_generic_read64(f, &cb, buf_size, fifo_read_cb);
+    return fifo_generic_read64(f, dest, buf_size, NULL);
+}
+
+int fifo_generic_read64(fifo_buffer *f, void *dest, size_t buf_size,
+                        void (*func)(void *, void *, size_t))
+{
+    while (buf_size > 0) {
+        uint8_t *rptr = fifo_rptr(f);
+        size_t len = min(fifo_contig(f, f->rpos), buf_size);
         if (func)
-            func(dest, f->rptr, len);
+            func(dest, rptr, len);
         else {
-            memcpy(dest, f->rptr, len);
+            memcpy(dest, rptr, len);
             dest = (uint8_t *)dest + len;
         }
-// memory barrier needed for SMP here in theory
-        fifo_drain(f, len);
+        fifo_drain64(f, len);
         buf_size -= len;
-    } while (buf_size > 0);
+    }
     return 0;
 }
 
 /** Discard data from the FIFO. */
 void fifo_drain(fifo_buffer *f, int size)
 {
-    assert(fifo_size(f) >= size);
-    f->rptr += size;
-    if (f->rptr >= f->end)
-        f->rptr -= f->end - f->buffer;
-    f->rndx += size;
+    assert(size >= 0);
+    fifo_drain64(f, size);
+}
+
+void fifo_drain64(fifo_buffer *f, size_t size)
+{
+    uint64_t rndx = f->rndx + size;
+
+    assert(fifo_size64(f) >= size);
+    f->rpos = fifo_advance(f, f->rpos, rndx, size);
+    fifo_publish_rndx(f, rndx);
 }
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * a broadcast ring: one writer, several readers with their own read cursor
+ */
+
+#include <fifo_bcast.h>
+#include <stdlib.h>
+#include <string.h>
+#include <compiler.h>
+
+fifo_bcast *fifo_bcast_alloc(size_t size, int nb_readers, int flags)
+{
+    fifo_bcast *b;
+
+    if (nb_readers <= 0)
+        return NULL;
+    b = calloc(1, sizeof(*b));
+    if (!b)
+        return NULL;
+    if (posix_memalign((void **)&b->readers, L1_CACHE_BYTES,
+                       nb_readers * sizeof(*b->readers)))
+        goto fail;
+    memset(b->readers, 0, nb_readers * sizeof(*b->readers));
+    b->nb_readers = nb_readers;
+
+    /* readers locate their data by masking their own index */
+    b->fifo = fifo_alloc2(size, flags | FIFO_FLAG_POW2);
+    if (!b->fifo)
+        goto fail;
+    return b;
+
+fail:
+    free(b->readers);
+    free(b);
+    return NULL;
+}
+
+void fifo_bcast_free(fifo_bcast *b)
+{
+    if (b) {
+        fifo_free(b->fifo);
+        free(b->readers);
+        free(b);
+    }
+}
+
+void fifo_bcast_set_lossy(fifo_bcast *b, int reader, int lossy)
+{
+    struct fifo_bcast_reader *r = &b->readers[reader];
+
+    /*
+     * An overrun lossy reader may lag the writer by more than the ring;
+     * skip it to the oldest data still held before it holds the writer
+     * back again, or fifo_bcast_space() would underflow.
+     */
+    if (!lossy && r->rndx < b->tail) {
+        r->lost += b->tail - r->rndx;
+        smp_store_release(&r->rndx, b->tail);
+    }
+    WRITE_ONCE(r->lossy, !!lossy);
+}
+
+size_t fifo_bcast_space(const fifo_bcast *b)
+{
+    const fifo_buffer *f = b->fifo;
+    uint64_t wndx = f->wndx, low = wndx;
+    int i;
+
+    for (i = 0; i < b->nb_readers; i++) {
+        const struct fifo_bcast_reader *r = &b->readers[i];
+
+        if (!READ_ONCE(r->lossy))
+            low = min(low, smp_load_acquire(&r->rndx));
+    }
+    return f->size - (wndx - low);
+}
+
+size_t fifo_bcast_write(fifo_bcast *b, const void *src, size_t size)
+{
+    fifo_buffer *f = b->fifo;
+    size_t bufsize = f->size;
+    uint64_t end;
+
+    size = min(size, fifo_bcast_space(b));
+    if (!size)
+        return 0;
+
+    end = f->wndx + size;
+    if (end > bufsize && end - bufsize > b->tail) {
+        /*
+         * Announce the overwrite before doing it, lossy readers check the
+         * tail after copying and drop what may have been overwritten.
+         */
+        WRITE_ONCE(b->tail, end - bufsize);
+        smp_wmb();
+        fifo_drain64(f, b->tail - f->rndx);
+    }
+    return fifo_generic_write64(f, (void *)src, size, NULL);
+}
+
+size_t fifo_bcast_size(const fifo_bcast *b, int reader)
+{
+    const fifo_buffer *f = b->fifo;
+    uint64_t avail = smp_load_acquire(&f->wndx) - b->readers[reader].rndx;
+
+    return min(avail, (uint64_t)f->size);
+}
+
+static void fifo_bcast_copy(const fifo_buffer *f, void *dest, uint64_t ndx,
+                            size_t size)
+{
+    size_t pos = ndx & f->mask;
+    size_t len = size;
+
+    if (!(f->flags & FIFO_FLAG_MIRRORED))
+        len = min(size, f->size - pos);
+    memcpy(dest, fifo_data(f) + pos, len);
+    memcpy((uint8_t *)dest + len, fifo_data(f), size - len);
+}
+
+size_t fifo_bcast_read(fifo_bcast *b, int reader, void *dest, size_t size)
+{
+    const fifo_buffer *f = b->fifo;
+    struct fifo_bcast_reader *r = &b->readers[reader];
+
+    for (;;) {
+        uint64_t start = r->rndx;
+        uint64_t wndx, tail;
+        size_t len;
+
+        if (r->lossy) {
+            tail = smp_load_acquire(&b->tail);
+            if (start < tail) {
+                r->lost += tail - start;
+                start = tail;
+            }
+        }
+
+        /*
+         * Load wndx after the tail: a lossy reader does not hold the
+         * writer back, so a wndx loaded first may already be more than
+         * a ring behind the tail. Clamp anyway, start past wndx or a
+         * length above the ring would copy outside of it.
+         */
+        wndx = smp_load_acquire(&f->wndx);
+        len = 0;
+        if (start < wndx)
+            len = min(min(size, (size_t)(wndx - start)), f->size);
+        fifo_bcast_copy(f, dest, start, len);
+
+        if (r->lossy) {
+            /* pairs with smp_wmb() in fifo_bcast_write() */
+            smp_rmb();
+            tail = READ_ONCE(b->tail);
+            if (tail > start) {
+                /* overwritten while copying, skip to the new tail */
+                r->lost += tail - start;
+                smp_store_release(&r->rndx, tail);
+                continue;
+            }
+        }
+        smp_store_release(&r->rndx, start + len);
+        return len;
+    }
+}
+
+uint64_t fifo_bcast_lost(const fifo_bcast *b, int reader)
+{
+    return b->readers[reader].lost;
+}
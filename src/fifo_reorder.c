@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * sequence number reorder (jitter) buffer
+ */
+
+#include <fifo_reorder.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <compiler.h>
+
+static inline struct fifo_reorder_slot *fifo_reorder_slot(const fifo_reorder *r,
+                                                          uint64_t seq)
+{
+    return (struct fifo_reorder_slot *)fifo_data(r->ring) + (seq & r->mask);
+}
+
+fifo_reorder *fifo_reorder_alloc(size_t slots, uint64_t timeout)
+{
+    fifo_reorder *r;
+
+    if (!slots || slots > SIZE_MAX / sizeof(struct fifo_reorder_slot))
+        return NULL;
+    r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    /* the slot size is a power of two, so the ring rounds to whole slots */
+    r->ring = fifo_alloc2(slots * sizeof(struct fifo_reorder_slot), FIFO_FLAG_POW2);
+    if (!r->ring) {
+        free(r);
+        return NULL;
+    }
+    memset(fifo_data(r->ring), 0, r->ring->size);
+    r->mask    = r->ring->size / sizeof(struct fifo_reorder_slot) - 1;
+    r->timeout = timeout;
+    return r;
+}
+
+void fifo_reorder_free(fifo_reorder *r, void (*free_pkt)(void *))
+{
+    void *pkt;
+
+    if (!r)
+        return;
+    while (free_pkt && (pkt = fifo_reorder_flush(r, NULL)))
+        free_pkt(pkt);
+    fifo_free(r->ring);
+    free(r);
+}
+
+int fifo_reorder_insert(fifo_reorder *r, uint64_t seq, uint64_t now, void *pkt)
+{
+    struct fifo_reorder_slot *s;
+
+    if (!r->started) {
+        r->next    = seq;
+        r->started = 1;
+    }
+    if (seq < r->next) {
+        r->late++;
+        return -EALREADY;
+    }
+    if (seq - r->next > r->mask)
+        return -ENOSPC;
+
+    s = fifo_reorder_slot(r, seq);
+    if (s->pkt) {
+        r->duplicate++;
+        return -EEXIST;
+    }
+    s->seq = seq;
+    s->ts  = now;
+    s->pkt = pkt;
+    if (!r->count++ || seq < r->first)
+        r->first = seq;
+    return 0;
+}
+
+/* Take the packet of sequence number first out and make next follow it. */
+static void *fifo_reorder_take(fifo_reorder *r, uint64_t *seq)
+{
+    struct fifo_reorder_slot *s = fifo_reorder_slot(r, r->first);
+    void *pkt = s->pkt;
+
+    r->lost += r->first - r->next;
+    r->next  = r->first + 1;
+    if (seq)
+        *seq = r->first;
+    s->pkt = NULL;
+
+    /* every slot walked here is behind the new first, and skipped once */
+    if (--r->count)
+        while (!fifo_reorder_slot(r, ++r->first)->pkt)
+            ;
+    return pkt;
+}
+
+void *fifo_reorder_pop(fifo_reorder *r, uint64_t now, uint64_t *seq)
+{
+    if (!r->count)
+        return NULL;
+    if (r->first != r->next) {
+        uint64_t ts = fifo_reorder_slot(r, r->first)->ts;
+
+        /* a now older than ts is not a timeout, and must not wrap into one */
+        if (!(now >= ts && now - ts >= r->timeout))
+            return NULL;
+    }
+    return fifo_reorder_take(r, seq);
+}
+
+void *fifo_reorder_flush(fifo_reorder *r, uint64_t *seq)
+{
+    if (!r->count)
+        return NULL;
+    return fifo_reorder_take(r, seq);
+}
+
+size_t fifo_reorder_count(const fifo_reorder *r)
+{
+    return r->count;
+}
@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * asynchronous fill and drain of a fifo_buffer with io_uring
+ */
+
+#include <fifo_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <compiler.h>
+
+struct fifo_uring_req {
+    size_t len;
+    int res;
+    int done;
+};
+
+struct fifo_uring {
+    fifo_buffer *fifo;
+    int fd;
+    int drain;          /* writes the data out instead of reading in */
+    int64_t offset;     /* file offset of the next byte to commit, -1 */
+    size_t chunk;
+    unsigned int depth;
+    int eof;
+    int error;          /* negative errno of the first failed request */
+    int stop;           /* issue nothing until the requests are done */
+
+    /* requests in issue order, [head, tail) are in flight */
+    struct fifo_uring_req *reqs;
+    unsigned int head, tail;
+    size_t queued;      /* bytes covered by the requests in flight */
+
+    int ring_fd;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int fifo_uring_setup(fifo_uring *u)
+{
+    struct io_uring_params p;
+    uint8_t *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = syscall(__NR_io_uring_setup, u->depth, &p);
+    if (u->ring_fd < 0)
+        return -errno;
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size    = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+    u->sqes    = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED ||
+        u->sqes == MAP_FAILED)
+        return -ENOMEM;
+
+    sq = u->sq_ring;
+    u->sq_head  = (unsigned int *)(sq + p.sq_off.head);
+    u->sq_tail  = (unsigned int *)(sq + p.sq_off.tail);
+    u->sq_mask  = (unsigned int *)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned int *)(sq + p.sq_off.array);
+    cq = u->cq_ring;
+    u->cq_head  = (unsigned int *)(cq + p.cq_off.head);
+    u->cq_tail  = (unsigned int *)(cq + p.cq_off.tail);
+    u->cq_mask  = (unsigned int *)(cq + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void fifo_uring_teardown(fifo_uring *u)
+{
+    if (u->sqes && u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring && u->cq_ring != MAP_FAILED)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring && u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    if (u->ring_fd >= 0)
+        close(u->ring_fd);
+}
+
+static fifo_uring *fifo_uring_alloc(fifo_buffer *f, int fd, int64_t offset,
+                                    unsigned int depth, size_t chunk, int drain)
+{
+    fifo_uring *u;
+    int ret;
+
+    if (!depth || !chunk) {
+        errno = EINVAL;
+        return NULL;
+    }
+    u = calloc(1, sizeof(*u));
+    if (!u)
+        return NULL;
+    u->fifo    = f;
+    u->fd      = fd;
+    u->drain   = drain;
+    u->offset  = offset < 0 ? -1 : offset;
+    /* requests on a stream would land in completion order, not file order */
+    u->depth   = u->offset < 0 ? 1 : depth;
+    u->chunk   = min(chunk, (size_t)INT_MAX);
+    u->ring_fd = -1;
+    u->reqs    = calloc(u->depth, sizeof(*u->reqs));
+    if (!u->reqs) {
+        free(u);
+        return NULL;
+    }
+    ret = fifo_uring_setup(u);
+    if (ret < 0) {
+        fifo_uring_teardown(u);
+        free(u->reqs);
+        free(u);
+        errno = -ret;
+        return NULL;
+    }
+    return u;
+}
+
+fifo_uring *fifo_uring_alloc_fill(fifo_buffer *f, int fd, int64_t offset,
+                                  unsigned int depth, size_t chunk)
+{
+    return fifo_uring_alloc(f, fd, offset, depth, chunk, 0);
+}
+
+fifo_uring *fifo_uring_alloc_drain(fifo_buffer *f, int fd, int64_t offset,
+                                   unsigned int depth, size_t chunk)
+{
+    return fifo_uring_alloc(f, fd, offset, depth, chunk, 1);
+}
+
+unsigned int fifo_uring_inflight(const fifo_uring *u)
+{
+    return u->tail - u->head;
+}
+
+unsigned int fifo_uring_depth(const fifo_uring *u)
+{
+    return u->depth;
+}
+
+int fifo_uring_eof(const fifo_uring *u)
+{
+    return u->eof;
+}
+
+/*
+ * Queue one request for the next chunk past the bytes already in flight:
+ * free space after the write position or data after the read position.
+ */
+static int fifo_uring_queue(fifo_uring *u)
+{
+    fifo_buffer *f = u->fifo;
+    struct fifo_uring_req *req;
+    struct io_uring_sqe *sqe;
+    size_t avail, pos, len;
+    unsigned int tail, idx;
+
+    avail = u->drain ? fifo_size64(f) : fifo_space64(f);
+    if (avail <= u->queued)
+        return 0;
+    pos = (u->drain ? f->rpos : f->wpos) + u->queued;
+    if (pos >= f->size)
+        pos -= f->size;
+    len = min(avail - u->queued, u->chunk);
+    if (!(f->flags & FIFO_FLAG_MIRRORED))
+        len = min(len, f->size - pos);
+
+    tail = *u->sq_tail;
+    idx  = tail & *u->sq_mask;
+    sqe  = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = u->drain ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = u->fd;
+    sqe->addr      = (uintptr_t)(fifo_data(f) + pos);
+    sqe->len       = len;
+    sqe->off       = u->offset < 0 ? (uint64_t)-1 : u->offset + u->queued;
+    sqe->user_data = u->tail % u->depth;
+    u->sq_array[idx] = idx;
+    smp_store_release(u->sq_tail, tail + 1);
+
+    req = &u->reqs[u->tail % u->depth];
+    req->len  = len;
+    req->done = 0;
+    u->tail++;
+    u->queued += len;
+    return 1;
+}
+
+static void fifo_uring_reap(fifo_uring *u)
+{
+    unsigned int head = *u->cq_head;
+
+    while (head != smp_load_acquire(u->cq_tail)) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        struct fifo_uring_req *req = &u->reqs[cqe->user_data];
+
+        req->res  = cqe->res;
+        req->done = 1;
+        head++;
+    }
+    smp_store_release(u->cq_head, head);
+}
+
+/*
+ * Hand the completed requests at the head over to the FIFO in issue order.
+ * After a short or failed request the ones behind it cover bytes that do
+ * not follow on, so they are dropped once complete.
+ */
+static size_t fifo_uring_retire(fifo_uring *u)
+{
+    size_t total = 0;
+
+    while (u->head != u->tail) {
+        struct fifo_uring_req *req = &u->reqs[u->head % u->depth];
+
+        if (!req->done)
+            break;
+        u->head++;
+        u->queued -= req->len;
+        if (u->stop)
+            continue;
+        if (req->res < 0) {
+            if (req->res != -EAGAIN && req->res != -EINTR)
+                u->error = req->res;
+            u->stop = 1;
+            continue;
+        }
+        if (u->drain)
+            fifo_read_release(u->fifo, req->res);
+        else
+            fifo_write_commit(u->fifo, req->res);
+        total += req->res;
+        if (u->offset >= 0)
+            u->offset += req->res;
+        if (!req->res && !u->drain)
+            u->eof = 1;
+        if ((size_t)req->res < req->len)
+            u->stop = 1;
+    }
+    if (u->head == u->tail && !u->eof && !u->error)
+        u->stop = 0;
+    return total;
+}
+
+static int fifo_uring_enter(fifo_uring *u, unsigned int to_submit,
+                            unsigned int min_complete)
+{
+    unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+
+    do {
+        ret = syscall(__NR_io_uring_enter, u->ring_fd, to_submit,
+                      min_complete, flags, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? -errno : ret;
+}
+
+ssize_t fifo_uring_run(fifo_uring *u, unsigned int min_complete)
+{
+    unsigned int to_submit;
+    size_t total;
+    int ret;
+
+    while (!u->stop && !u->eof && !u->error &&
+           fifo_uring_inflight(u) < u->depth && fifo_uring_queue(u))
+        ;
+
+    /* the kernel may have left entries of an earlier call unconsumed */
+    to_submit = *u->sq_tail - smp_load_acquire(u->sq_head);
+    min_complete = min(min_complete, fifo_uring_inflight(u));
+    if (to_submit || min_complete) {
+        ret = fifo_uring_enter(u, to_submit, min_complete);
+        if (ret < 0 && ret != -EAGAIN && ret != -EBUSY)
+            return ret;
+    }
+
+    fifo_uring_reap(u);
+    total = fifo_uring_retire(u);
+    if (!total && u->error)
+        return u->error;
+    return total;
+}
+
+void fifo_uring_free(fifo_uring *u)
+{
+    if (!u)
+        return;
+    /* the kernel may still be writing into or reading from the FIFO */
+    u->stop = 1;
+    while (fifo_uring_inflight(u)) {
+        if (fifo_uring_enter(u, 0, 1) < 0)
+            break;
+        fifo_uring_reap(u);
+        fifo_uring_retire(u);
+    }
+    fifo_uring_teardown(u);
+    free(u->reqs);
+    free(u);
+}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * sliding window aggregates over a ring of timestamped samples
+ */
+
+#include <fifo_window.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <compiler.h>
+
+#define SUB_BITS    FIFO_WINDOW_SUB_BITS
+#define SUB_COUNT   (1 << SUB_BITS)
+
+/*
+ * Values below SUB_COUNT get a bucket each, larger ones keep their leading
+ * SUB_BITS + 1 bits: octave e - SUB_BITS + 1 for a value in [2^e, 2^(e+1)).
+ */
+static inline unsigned int fifo_window_bucket(uint64_t value)
+{
+    unsigned int e;
+
+    if (value < SUB_COUNT)
+        return value;
+    e = 63 - __clzl(value);
+    return (e - SUB_BITS + 1) << SUB_BITS |
+           ((value >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+/* Middle of the range of values that fall into a bucket. */
+static uint64_t fifo_window_bucket_value(unsigned int idx)
+{
+    unsigned int octave = idx >> SUB_BITS, shift;
+    uint64_t low;
+
+    if (!octave)
+        return idx;
+    shift = octave - 1;
+    low   = (uint64_t)(SUB_COUNT | (idx & (SUB_COUNT - 1))) << shift;
+    return low + ((1ULL << shift) - 1) / 2;
+}
+
+static int fifo_window_deque_init(struct fifo_window_deque *d, size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+    d->entry = malloc(size * sizeof(*d->entry));
+    d->mask  = size - 1;
+    d->head  = d->tail = 0;
+    return d->entry ? 0 : ENOMEM;
+}
+
+static inline struct fifo_window_entry *
+fifo_window_deque_at(const struct fifo_window_deque *d, uint64_t ndx)
+{
+    return &d->entry[ndx & d->mask];
+}
+
+/*
+ * Drop from the back every entry the new value makes irrelevant, the ones
+ * it beats (max) or undercuts (min), then append it.
+ */
+static void fifo_window_deque_push(struct fifo_window_deque *d, uint64_t seq,
+                                   uint64_t value, int is_max)
+{
+    struct fifo_window_entry *e;
+
+    while (d->tail != d->head) {
+        uint64_t back = fifo_window_deque_at(d, d->tail - 1)->value;
+
+        if (is_max ? back > value : back < value)
+            break;
+        d->tail--;
+    }
+    e = fifo_window_deque_at(d, d->tail++);
+    e->seq   = seq;
+    e->value = value;
+}
+
+static void fifo_window_deque_evict(struct fifo_window_deque *d, uint64_t seq)
+{
+    if (d->tail != d->head && fifo_window_deque_at(d, d->head)->seq == seq)
+        d->head++;
+}
+
+fifo_window *fifo_window_alloc(size_t capacity, uint64_t span)
+{
+    fifo_window *w;
+
+    if (!capacity)
+        return NULL;
+    w = calloc(1, sizeof(*w));
+    if (!w)
+        return NULL;
+    w->capacity = capacity;
+    w->span     = span;
+    w->samples  = fifo_alloc_array(capacity, sizeof(struct fifo_window_sample));
+    if (!w->samples ||
+        fifo_window_deque_init(&w->min, capacity) ||
+        fifo_window_deque_init(&w->max, capacity)) {
+        fifo_window_free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void fifo_window_free(fifo_window *w)
+{
+    if (!w)
+        return;
+    fifo_free(w->samples);
+    free(w->min.entry);
+    free(w->max.entry);
+    free(w);
+}
+
+static void fifo_window_evict(fifo_window *w)
+{
+    struct fifo_window_sample s;
+    unsigned int idx;
+
+    fifo_generic_read64(w->samples, &s, sizeof(s), NULL);
+    fifo_window_deque_evict(&w->min, w->seq);
+    fifo_window_deque_evict(&w->max, w->seq);
+    idx = fifo_window_bucket(s.value);
+    w->bucket[idx]--;
+    w->octave[idx >> SUB_BITS]--;
+    w->sum -= s.value;
+    w->count--;
+    w->seq++;
+}
+
+void fifo_window_expire(fifo_window *w, uint64_t now)
+{
+    struct fifo_window_sample s;
+
+    if (!w->span || now < w->span)
+        return;
+    while (w->count) {
+        fifo_generic_peek_at64(w->samples, &s, 0, sizeof(s), NULL);
+        if (s.ts > now - w->span)
+            break;
+        fifo_window_evict(w);
+    }
+}
+
+int fifo_window_push(fifo_window *w, uint64_t ts, uint64_t value)
+{
+    struct fifo_window_sample s = { .ts = ts, .value = value };
+    uint64_t seq = w->seq + w->count;
+    unsigned int idx;
+
+    if (w->count) {
+        struct fifo_window_sample last;
+
+        fifo_generic_peek_at64(w->samples, &last, (w->count - 1) * sizeof(last),
+                               sizeof(last), NULL);
+        if (ts < last.ts)
+            return -EINVAL;
+    }
+    fifo_window_expire(w, ts);
+    if (w->count == w->capacity)
+        fifo_window_evict(w);
+
+    fifo_generic_write64(w->samples, &s, sizeof(s), NULL);
+    fifo_window_deque_push(&w->min, seq, value, 0);
+    fifo_window_deque_push(&w->max, seq, value, 1);
+    idx = fifo_window_bucket(value);
+    w->bucket[idx]++;
+    w->octave[idx >> SUB_BITS]++;
+    w->sum += value;
+    w->count++;
+    return 0;
+}
+
+size_t fifo_window_count(const fifo_window *w)
+{
+    return w->count;
+}
+
+uint64_t fifo_window_sum(const fifo_window *w)
+{
+    return w->sum;
+}
+
+double fifo_window_mean(const fifo_window *w)
+{
+    return w->count ? (double)w->sum / w->count : 0;
+}
+
+uint64_t fifo_window_min(const fifo_window *w)
+{
+    return w->count ? fifo_window_deque_at(&w->min, w->min.head)->value : 0;
+}
+
+uint64_t fifo_window_max(const fifo_window *w)
+{
+    return w->count ? fifo_window_deque_at(&w->max, w->max.head)->value : 0;
+}
+
+uint64_t fifo_window_quantile(const fifo_window *w, double q)
+{
+    size_t rank, seen = 0;
+    unsigned int o, idx;
+    uint64_t value;
+
+    if (!w->count)
+        return 0;
+    q = q < 0 ? 0 : q > 1 ? 1 : q;
+    rank = q * w->count;
+    if (rank < q * w->count || !rank)
+        rank++;
+
+    for (o = 0; seen + w->octave[o] < rank; o++)
+        seen += w->octave[o];
+    for (idx = o << SUB_BITS; seen + w->bucket[idx] < rank; idx++)
+        seen += w->bucket[idx];
+
+    value = fifo_window_bucket_value(idx);
+    return max(min(value, fifo_window_max(w)), fifo_window_min(w));
+}
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Resizable hash table with incremental rehashing
+ */
+#include <rhash.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * calloc() of a large array maps zero pages on demand, so starting a
+ * resize does not touch the whole new array up front either.
+ */
+static struct hlist_head *rhash_alloc_buckets(unsigned int bits)
+{
+	return calloc((size_t)1 << bits, sizeof(struct hlist_head));
+}
+
+int rhash_init(struct rhash_table *t, unsigned int min_bits)
+{
+	if (min_bits < RHASH_MIN_BITS)
+		min_bits = RHASH_MIN_BITS;
+	t->tbl[0] = rhash_alloc_buckets(min_bits);
+	if (!t->tbl[0])
+		return -ENOMEM;
+	t->tbl[1] = NULL;
+	t->bits[0] = min_bits;
+	t->bits[1] = 0;
+	t->nelems = 0;
+	t->rehash_idx = 0;
+	t->min_bits = min_bits;
+	return 0;
+}
+
+void rhash_destroy(struct rhash_table *t)
+{
+	free(t->tbl[0]);
+	free(t->tbl[1]);
+	t->tbl[0] = t->tbl[1] = NULL;
+}
+
+static void rhash_start(struct rhash_table *t, unsigned int bits)
+{
+	struct hlist_head *tbl;
+
+	if (bits == t->bits[0])
+		return;
+	tbl = rhash_alloc_buckets(bits);
+	if (!tbl)
+		return;
+	t->tbl[1] = tbl;
+	t->bits[1] = bits;
+	t->rehash_idx = 0;
+}
+
+bool rhash_rehash(struct rhash_table *t, size_t nb_buckets)
+{
+	struct hlist_node *pos, *tmp;
+	struct rhash_node *n;
+	size_t size0;
+
+	if (!rhash_rehashing(t))
+		return false;
+
+	size0 = rhash_size(t, 0);
+	for (; nb_buckets && t->rehash_idx < size0; nb_buckets--) {
+		hlist_for_each_safe(pos, tmp, &t->tbl[0][t->rehash_idx]) {
+			/* the whole bucket moves, no need to unlink */
+			n = (struct rhash_node *)pos;	/* node comes first */
+			hlist_add_head(pos, &t->tbl[1][n->hash >> (64 - t->bits[1])]);
+		}
+		INIT_HLIST_HEAD(&t->tbl[0][t->rehash_idx]);
+		t->rehash_idx++;
+	}
+	if (t->rehash_idx < size0)
+		return true;
+
+	free(t->tbl[0]);
+	t->tbl[0] = t->tbl[1];
+	t->bits[0] = t->bits[1];
+	t->tbl[1] = NULL;
+	t->bits[1] = 0;
+	t->rehash_idx = 0;
+	return false;
+}
+
+/*
+ * Growing at a load of 1 and migrating RHASH_STEP buckets per insert
+ * drains the old array well before the new one reaches a load of 1 in
+ * turn, so a resize never has to wait for the previous one.
+ */
+void rhash_add(struct rhash_table *t, struct rhash_node *n, uint64_t hash)
+{
+	int k;
+
+	rhash_step(t);
+	n->hash = hash;
+	k = rhash_rehashing(t);
+	hlist_add_head(&n->node, &t->tbl[k][hash >> (64 - t->bits[k])]);
+	t->nelems++;
+
+	if (!rhash_rehashing(t) && t->nelems > rhash_size(t, 0) &&
+	    t->bits[0] < 8 * sizeof(size_t) - 1)
+		rhash_start(t, t->bits[0] + 1);
+}
+
+void rhash_del(struct rhash_table *t, struct rhash_node *n)
+{
+	unsigned int bits;
+
+	hlist_del_init(&n->node);
+	t->nelems--;
+
+	/* shrink to a load of 1/4 to 1/2, so the next grow is far away */
+	if (rhash_rehashing(t) || t->bits[0] <= t->min_bits ||
+	    t->nelems >= rhash_size(t, 0) / 8)
+		return;
+	for (bits = t->min_bits; ((size_t)1 << bits) < 2 * t->nelems; bits++)
+		;
+	rhash_start(t, bits);
+}
@@ -57,6 +57,18 @@ static unsigned int kmp_find(struct ts_config *conf, struct ts_state *state)
 			break;
 
 		for (i = 0; i < text_len; i++) {
+			/*
+			 * Outside a partial match only the first pattern byte
+			 * can start one; let the vectorized memchr() skip to it.
+			 */
+			if (q == 0 && !icase) {
+				const u8 *next = memchr(text + i, kmp->pattern[0],
+							text_len - i);
+
+				if (!next)
+					break;
+				i = next - text;
+			}
 			while (q > 0 && kmp->pattern[q]
 			    != (icase ? toupper(text[i]) : text[i]))
 				q = kmp->prefix_tbl[q - 1];
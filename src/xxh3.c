@@ -0,0 +1,952 @@
+/*
+ * xxHash - Extremely Fast Hash algorithm, XXH3 variant
+ * Copyright (C) 2012-2021, Yann Collet.
+ *
+ * BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation. This program is dual-licensed; you may select
+ * either version 2 of the GNU General Public License ("GPL") or BSD license
+ * ("BSD").
+ *
+ * You can contact the author at:
+ * - xxHash homepage: http://cyan4973.github.io/xxHash/
+ * - xxHash source repository: https://github.com/Cyan4973/xxHash
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <xxhash.h>
+#include <compiler.h>
+#include <cpufeature.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XXH3_X86	1
+#endif
+
+/*-*************************************
+ * Macros
+ **************************************/
+#define xxh_rotl32(x, r) ((x << r) | (x >> (32 - r)))
+#define xxh_rotl64(x, r) ((x << r) | (x >> (64 - r)))
+
+#define STRIPE_LEN		64
+#define SECRET_CONSUME_RATE	8
+#define ACC_NB			(STRIPE_LEN / sizeof(uint64_t))
+#define SECRET_SIZE_MIN		136
+#define SECRET_LASTACC_START	7
+#define SECRET_MERGEACCS_START	11
+#define MIDSIZE_MAX		240
+#define MIDSIZE_STARTOFFSET	3
+#define MIDSIZE_LASTOFFSET	17
+#define BUFFER_STRIPES		(XXH3_BUFFER_SIZE / STRIPE_LEN)
+#define SECRET_LIMIT		(XXH3_SECRET_SIZE - STRIPE_LEN)
+#define STRIPES_PER_BLOCK	(SECRET_LIMIT / SECRET_CONSUME_RATE)
+
+/*-*************************************
+ * Constants
+ **************************************/
+static const uint32_t PRIME32_1 = 2654435761U;
+static const uint32_t PRIME32_2 = 2246822519U;
+static const uint32_t PRIME32_3 = 3266489917U;
+
+static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+static const uint64_t PRIME64_3 =  1609587929392839161ULL;
+static const uint64_t PRIME64_4 =  9650029242287828579ULL;
+static const uint64_t PRIME64_5 =  2870177450012600261ULL;
+
+static const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+static const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+/* pseudorandom default secret, from the reference implementation */
+static const uint8_t xxh3_secret[XXH3_SECRET_SIZE] __aligned(64) = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+/*-**************************
+ *  Utils
+ ***************************/
+static inline uint32_t xxh3_read32(const void *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline uint64_t xxh3_read64(const void *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline void xxh3_write64(void *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline struct xxh128_hash xxh3_mul128(uint64_t a, uint64_t b)
+{
+	unsigned __int128 product = (unsigned __int128)a * b;
+	struct xxh128_hash r = { (uint64_t)product, (uint64_t)(product >> 64) };
+
+	return r;
+}
+
+static inline uint64_t xxh3_mul128_fold64(uint64_t a, uint64_t b)
+{
+	struct xxh128_hash product = xxh3_mul128(a, b);
+
+	return product.low64 ^ product.high64;
+}
+
+static inline uint64_t xxh3_xorshift64(uint64_t v, int shift)
+{
+	return v ^ (v >> shift);
+}
+
+static uint64_t xxh64_avalanche(uint64_t h64)
+{
+	h64 ^= h64 >> 33;
+	h64 *= PRIME64_2;
+	h64 ^= h64 >> 29;
+	h64 *= PRIME64_3;
+	h64 ^= h64 >> 32;
+	return h64;
+}
+
+static uint64_t xxh3_avalanche(uint64_t h64)
+{
+	h64 = xxh3_xorshift64(h64, 37);
+	h64 *= PRIME_MX1;
+	h64 = xxh3_xorshift64(h64, 32);
+	return h64;
+}
+
+static uint64_t xxh3_rrmxmx(uint64_t h64, uint64_t len)
+{
+	h64 ^= xxh_rotl64(h64, 49) ^ xxh_rotl64(h64, 24);
+	h64 *= PRIME_MX2;
+	h64 ^= (h64 >> 35) + len;
+	h64 *= PRIME_MX2;
+	return xxh3_xorshift64(h64, 28);
+}
+
+/*-***************************
+ * Short inputs, 64-bit
+ ****************************/
+static uint64_t xxh3_len_1to3_64(const uint8_t *p, size_t len,
+				 const uint8_t *secret, uint64_t seed)
+{
+	const uint32_t combined = ((uint32_t)p[0] << 16) |
+		((uint32_t)p[len >> 1] << 24) | p[len - 1] | ((uint32_t)len << 8);
+	const uint64_t bitflip = (xxh3_read32(secret) ^
+				  xxh3_read32(secret + 4)) + seed;
+
+	return xxh64_avalanche(combined ^ bitflip);
+}
+
+static uint64_t xxh3_len_4to8_64(const uint8_t *p, size_t len,
+				 const uint8_t *secret, uint64_t seed)
+{
+	const uint32_t in1 = xxh3_read32(p);
+	const uint32_t in2 = xxh3_read32(p + len - 4);
+	uint64_t bitflip, input64;
+
+	seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+	bitflip = (xxh3_read64(secret + 8) ^ xxh3_read64(secret + 16)) - seed;
+	input64 = in2 + ((uint64_t)in1 << 32);
+	return xxh3_rrmxmx(input64 ^ bitflip, len);
+}
+
+static uint64_t xxh3_len_9to16_64(const uint8_t *p, size_t len,
+				  const uint8_t *secret, uint64_t seed)
+{
+	const uint64_t bitflip1 = (xxh3_read64(secret + 24) ^
+				   xxh3_read64(secret + 32)) + seed;
+	const uint64_t bitflip2 = (xxh3_read64(secret + 40) ^
+				   xxh3_read64(secret + 48)) - seed;
+	const uint64_t lo = xxh3_read64(p) ^ bitflip1;
+	const uint64_t hi = xxh3_read64(p + len - 8) ^ bitflip2;
+	const uint64_t acc = len + __builtin_bswap64(lo) + hi +
+		xxh3_mul128_fold64(lo, hi);
+
+	return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_0to16_64(const uint8_t *p, size_t len,
+				  const uint8_t *secret, uint64_t seed)
+{
+	if (len > 8)
+		return xxh3_len_9to16_64(p, len, secret, seed);
+	if (len >= 4)
+		return xxh3_len_4to8_64(p, len, secret, seed);
+	if (len)
+		return xxh3_len_1to3_64(p, len, secret, seed);
+	return xxh64_avalanche(seed ^ xxh3_read64(secret + 56) ^
+			       xxh3_read64(secret + 64));
+}
+
+static inline uint64_t xxh3_mix16(const uint8_t *p, const uint8_t *secret,
+				  uint64_t seed)
+{
+	const uint64_t lo = xxh3_read64(p);
+	const uint64_t hi = xxh3_read64(p + 8);
+
+	return xxh3_mul128_fold64(lo ^ (xxh3_read64(secret) + seed),
+				  hi ^ (xxh3_read64(secret + 8) - seed));
+}
+
+static uint64_t xxh3_len_17to128_64(const uint8_t *p, size_t len,
+				    const uint8_t *secret, uint64_t seed)
+{
+	uint64_t acc = len * PRIME64_1;
+
+	if (len > 32) {
+		if (len > 64) {
+			if (len > 96) {
+				acc += xxh3_mix16(p + 48, secret + 96, seed);
+				acc += xxh3_mix16(p + len - 64, secret + 112, seed);
+			}
+			acc += xxh3_mix16(p + 32, secret + 64, seed);
+			acc += xxh3_mix16(p + len - 48, secret + 80, seed);
+		}
+		acc += xxh3_mix16(p + 16, secret + 32, seed);
+		acc += xxh3_mix16(p + len - 32, secret + 48, seed);
+	}
+	acc += xxh3_mix16(p, secret, seed);
+	acc += xxh3_mix16(p + len - 16, secret + 16, seed);
+	return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_129to240_64(const uint8_t *p, size_t len,
+				     const uint8_t *secret, uint64_t seed)
+{
+	const unsigned int nb_rounds = len / 16;
+	uint64_t acc = len * PRIME64_1;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		acc += xxh3_mix16(p + 16 * i, secret + 16 * i, seed);
+	acc = xxh3_avalanche(acc);
+	for (i = 8; i < nb_rounds; i++)
+		acc += xxh3_mix16(p + 16 * i,
+				  secret + 16 * (i - 8) + MIDSIZE_STARTOFFSET, seed);
+	acc += xxh3_mix16(p + len - 16,
+			  secret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET, seed);
+	return xxh3_avalanche(acc);
+}
+
+/*-***************************
+ * Short inputs, 128-bit
+ ****************************/
+static struct xxh128_hash xxh3_len_1to3_128(const uint8_t *p, size_t len,
+					    const uint8_t *secret, uint64_t seed)
+{
+	const uint32_t combinedl = ((uint32_t)p[0] << 16) |
+		((uint32_t)p[len >> 1] << 24) | p[len - 1] | ((uint32_t)len << 8);
+	const uint32_t swapped = __builtin_bswap32(combinedl);
+	const uint32_t combinedh = xxh_rotl32(swapped, 13);
+	const uint64_t bitflipl = (xxh3_read32(secret) ^
+				   xxh3_read32(secret + 4)) + seed;
+	const uint64_t bitfliph = (xxh3_read32(secret + 8) ^
+				   xxh3_read32(secret + 12)) - seed;
+	struct xxh128_hash h;
+
+	h.low64  = xxh64_avalanche(combinedl ^ bitflipl);
+	h.high64 = xxh64_avalanche(combinedh ^ bitfliph);
+	return h;
+}
+
+static struct xxh128_hash xxh3_len_4to8_128(const uint8_t *p, size_t len,
+					    const uint8_t *secret, uint64_t seed)
+{
+	const uint32_t in_lo = xxh3_read32(p);
+	const uint32_t in_hi = xxh3_read32(p + len - 4);
+	const uint64_t input64 = in_lo + ((uint64_t)in_hi << 32);
+	uint64_t bitflip;
+	struct xxh128_hash m;
+
+	seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+	bitflip = (xxh3_read64(secret + 16) ^ xxh3_read64(secret + 24)) + seed;
+	m = xxh3_mul128(input64 ^ bitflip, PRIME64_1 + (len << 2));
+	m.high64 += m.low64 << 1;
+	m.low64 ^= m.high64 >> 3;
+	m.low64 = xxh3_xorshift64(m.low64, 35);
+	m.low64 *= PRIME_MX2;
+	m.low64 = xxh3_xorshift64(m.low64, 28);
+	m.high64 = xxh3_avalanche(m.high64);
+	return m;
+}
+
+static struct xxh128_hash xxh3_len_9to16_128(const uint8_t *p, size_t len,
+					     const uint8_t *secret, uint64_t seed)
+{
+	const uint64_t bitflipl = (xxh3_read64(secret + 32) ^
+				   xxh3_read64(secret + 40)) - seed;
+	const uint64_t bitfliph = (xxh3_read64(secret + 48) ^
+				   xxh3_read64(secret + 56)) + seed;
+	const uint64_t input_lo = xxh3_read64(p);
+	uint64_t input_hi = xxh3_read64(p + len - 8);
+	struct xxh128_hash m, h;
+
+	m = xxh3_mul128(input_lo ^ input_hi ^ bitflipl, PRIME64_1);
+	m.low64 += (uint64_t)(len - 1) << 54;
+	input_hi ^= bitfliph;
+	m.high64 += input_hi + (uint64_t)(uint32_t)input_hi * (PRIME32_2 - 1);
+	m.low64 ^= __builtin_bswap64(m.high64);
+	h = xxh3_mul128(m.low64, PRIME64_2);
+	h.high64 += m.high64 * PRIME64_2;
+	h.low64  = xxh3_avalanche(h.low64);
+	h.high64 = xxh3_avalanche(h.high64);
+	return h;
+}
+
+static struct xxh128_hash xxh3_len_0to16_128(const uint8_t *p, size_t len,
+					     const uint8_t *secret, uint64_t seed)
+{
+	struct xxh128_hash h;
+
+	if (len > 8)
+		return xxh3_len_9to16_128(p, len, secret, seed);
+	if (len >= 4)
+		return xxh3_len_4to8_128(p, len, secret, seed);
+	if (len)
+		return xxh3_len_1to3_128(p, len, secret, seed);
+	h.low64  = xxh64_avalanche(seed ^ xxh3_read64(secret + 64) ^
+				   xxh3_read64(secret + 72));
+	h.high64 = xxh64_avalanche(seed ^ xxh3_read64(secret + 80) ^
+				   xxh3_read64(secret + 88));
+	return h;
+}
+
+static inline struct xxh128_hash xxh3_mix32(struct xxh128_hash acc,
+					    const uint8_t *p1, const uint8_t *p2,
+					    const uint8_t *secret, uint64_t seed)
+{
+	acc.low64  += xxh3_mix16(p1, secret, seed);
+	acc.low64  ^= xxh3_read64(p2) + xxh3_read64(p2 + 8);
+	acc.high64 += xxh3_mix16(p2, secret + 16, seed);
+	acc.high64 ^= xxh3_read64(p1) + xxh3_read64(p1 + 8);
+	return acc;
+}
+
+static struct xxh128_hash xxh3_finish_128(struct xxh128_hash acc, size_t len,
+					  uint64_t seed)
+{
+	struct xxh128_hash h;
+
+	h.low64  = acc.low64 + acc.high64;
+	h.high64 = acc.low64 * PRIME64_1 + acc.high64 * PRIME64_4 +
+		(len - seed) * PRIME64_2;
+	h.low64  = xxh3_avalanche(h.low64);
+	h.high64 = 0 - xxh3_avalanche(h.high64);
+	return h;
+}
+
+static struct xxh128_hash xxh3_len_17to128_128(const uint8_t *p, size_t len,
+					       const uint8_t *secret, uint64_t seed)
+{
+	struct xxh128_hash acc = { len * PRIME64_1, 0 };
+
+	if (len > 32) {
+		if (len > 64) {
+			if (len > 96)
+				acc = xxh3_mix32(acc, p + 48, p + len - 64,
+						 secret + 96, seed);
+			acc = xxh3_mix32(acc, p + 32, p + len - 48,
+					 secret + 64, seed);
+		}
+		acc = xxh3_mix32(acc, p + 16, p + len - 32, secret + 32, seed);
+	}
+	acc = xxh3_mix32(acc, p, p + len - 16, secret, seed);
+	return xxh3_finish_128(acc, len, seed);
+}
+
+static struct xxh128_hash xxh3_len_129to240_128(const uint8_t *p, size_t len,
+						const uint8_t *secret, uint64_t seed)
+{
+	const unsigned int nb_rounds = len / 32;
+	struct xxh128_hash acc = { len * PRIME64_1, 0 };
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		acc = xxh3_mix32(acc, p + 32 * i, p + 32 * i + 16,
+				 secret + 32 * i, seed);
+	acc.low64  = xxh3_avalanche(acc.low64);
+	acc.high64 = xxh3_avalanche(acc.high64);
+	for (i = 4; i < nb_rounds; i++)
+		acc = xxh3_mix32(acc, p + 32 * i, p + 32 * i + 16,
+				 secret + MIDSIZE_STARTOFFSET + 32 * (i - 4), seed);
+	acc = xxh3_mix32(acc, p + len - 16, p + len - 32,
+			 secret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET - 16,
+			 0 - seed);
+	return xxh3_finish_128(acc, len, seed);
+}
+
+/*-***************************
+ * Long inputs
+ ****************************/
+
+/*
+ * The accumulate and scramble kernels. Every stripe of 64 bytes is mixed
+ * into 8 independent 64-bit lanes, so the loop vectorizes over lanes; the
+ * SSE2, AVX2 and AVX-512 versions compute exactly what the scalar one
+ * does.
+ */
+struct xxh3_kernel {
+	void (*accumulate)(uint64_t *acc, const uint8_t *p,
+			   const uint8_t *secret, size_t nb_stripes);
+	void (*scramble)(uint64_t *acc, const uint8_t *secret);
+};
+
+static void xxh3_accumulate_scalar(uint64_t *acc, const uint8_t *p,
+				   const uint8_t *secret, size_t nb_stripes)
+{
+	size_t n, i;
+
+	for (n = 0; n < nb_stripes; n++) {
+		const uint8_t *in = p + n * STRIPE_LEN;
+		const uint8_t *key = secret + n * SECRET_CONSUME_RATE;
+
+		for (i = 0; i < ACC_NB; i++) {
+			const uint64_t data_val = xxh3_read64(in + 8 * i);
+			const uint64_t data_key = data_val ^ xxh3_read64(key + 8 * i);
+
+			acc[i ^ 1] += data_val;
+			acc[i] += (uint64_t)(uint32_t)data_key * (data_key >> 32);
+		}
+	}
+}
+
+static void xxh3_scramble_scalar(uint64_t *acc, const uint8_t *secret)
+{
+	size_t i;
+
+	for (i = 0; i < ACC_NB; i++) {
+		uint64_t a = acc[i];
+
+		a = xxh3_xorshift64(a, 47);
+		a ^= xxh3_read64(secret + 8 * i);
+		acc[i] = a * PRIME32_1;
+	}
+}
+
+static const struct xxh3_kernel xxh3_kernel_scalar = {
+	xxh3_accumulate_scalar, xxh3_scramble_scalar,
+};
+
+#ifdef XXH3_X86
+__attribute__((target("sse2")))
+static void xxh3_accumulate_sse2(uint64_t *acc, const uint8_t *p,
+				 const uint8_t *secret, size_t nb_stripes)
+{
+	__m128i a[4];
+	size_t n, i;
+
+	for (i = 0; i < 4; i++)
+		a[i] = _mm_loadu_si128((const __m128i *)acc + i);
+	for (n = 0; n < nb_stripes; n++) {
+		const __m128i *in = (const __m128i *)(p + n * STRIPE_LEN);
+		const __m128i *key = (const __m128i *)(secret +
+						       n * SECRET_CONSUME_RATE);
+
+		for (i = 0; i < 4; i++) {
+			__m128i data_vec = _mm_loadu_si128(in + i);
+			__m128i key_vec  = _mm_loadu_si128(key + i);
+			__m128i data_key = _mm_xor_si128(data_vec, key_vec);
+			/* 32x32->64 multiply of the halves of each lane */
+			__m128i data_key_lo = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m128i product  = _mm_mul_epu32(data_key, data_key_lo);
+			/* the input is added to the neighbouring lane */
+			__m128i data_swap = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+
+			a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, data_swap));
+		}
+	}
+	for (i = 0; i < 4; i++)
+		_mm_storeu_si128((__m128i *)acc + i, a[i]);
+}
+
+__attribute__((target("sse2")))
+static void xxh3_scramble_sse2(uint64_t *acc, const uint8_t *secret)
+{
+	const __m128i prime32 = _mm_set1_epi32((int)PRIME32_1);
+	size_t i;
+
+	for (i = 0; i < 4; i++) {
+		__m128i a = _mm_loadu_si128((const __m128i *)acc + i);
+		__m128i key_vec = _mm_loadu_si128((const __m128i *)secret + i);
+		__m128i data_key, data_key_hi, prod_lo, prod_hi;
+
+		a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+		data_key = _mm_xor_si128(a, key_vec);
+		data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+		prod_lo = _mm_mul_epu32(data_key, prime32);
+		prod_hi = _mm_mul_epu32(data_key_hi, prime32);
+		a = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+		_mm_storeu_si128((__m128i *)acc + i, a);
+	}
+}
+
+static const struct xxh3_kernel xxh3_kernel_sse2 = {
+	xxh3_accumulate_sse2, xxh3_scramble_sse2,
+};
+
+__attribute__((target("avx2")))
+static void xxh3_accumulate_avx2(uint64_t *acc, const uint8_t *p,
+				 const uint8_t *secret, size_t nb_stripes)
+{
+	__m256i a[2];
+	size_t n, i;
+
+	for (i = 0; i < 2; i++)
+		a[i] = _mm256_loadu_si256((const __m256i *)acc + i);
+	for (n = 0; n < nb_stripes; n++) {
+		const __m256i *in = (const __m256i *)(p + n * STRIPE_LEN);
+		const __m256i *key = (const __m256i *)(secret +
+						       n * SECRET_CONSUME_RATE);
+
+		for (i = 0; i < 2; i++) {
+			__m256i data_vec = _mm256_loadu_si256(in + i);
+			__m256i key_vec  = _mm256_loadu_si256(key + i);
+			__m256i data_key = _mm256_xor_si256(data_vec, key_vec);
+			__m256i data_key_lo = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m256i product  = _mm256_mul_epu32(data_key, data_key_lo);
+			__m256i data_swap = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+
+			a[i] = _mm256_add_epi64(a[i], _mm256_add_epi64(product, data_swap));
+		}
+	}
+	for (i = 0; i < 2; i++)
+		_mm256_storeu_si256((__m256i *)acc + i, a[i]);
+}
+
+__attribute__((target("avx2")))
+static void xxh3_scramble_avx2(uint64_t *acc, const uint8_t *secret)
+{
+	const __m256i prime32 = _mm256_set1_epi32((int)PRIME32_1);
+	size_t i;
+
+	for (i = 0; i < 2; i++) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)acc + i);
+		__m256i key_vec = _mm256_loadu_si256((const __m256i *)secret + i);
+		__m256i data_key, data_key_hi, prod_lo, prod_hi;
+
+		a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+		data_key = _mm256_xor_si256(a, key_vec);
+		data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+		prod_lo = _mm256_mul_epu32(data_key, prime32);
+		prod_hi = _mm256_mul_epu32(data_key_hi, prime32);
+		a = _mm256_add_epi64(prod_lo, _mm256_slli_epi64(prod_hi, 32));
+		_mm256_storeu_si256((__m256i *)acc + i, a);
+	}
+}
+
+static const struct xxh3_kernel xxh3_kernel_avx2 = {
+	xxh3_accumulate_avx2, xxh3_scramble_avx2,
+};
+
+__attribute__((target("avx512f")))
+static void xxh3_accumulate_avx512(uint64_t *acc, const uint8_t *p,
+				   const uint8_t *secret, size_t nb_stripes)
+{
+	__m512i a = _mm512_loadu_si512(acc);
+	size_t n;
+
+	/* a stripe is exactly one vector */
+	for (n = 0; n < nb_stripes; n++) {
+		__m512i data_vec = _mm512_loadu_si512(p + n * STRIPE_LEN);
+		__m512i key_vec  = _mm512_loadu_si512(secret + n * SECRET_CONSUME_RATE);
+		__m512i data_key = _mm512_xor_si512(data_vec, key_vec);
+		__m512i data_key_lo = _mm512_shuffle_epi32(data_key, (_MM_PERM_ENUM)_MM_SHUFFLE(0, 3, 0, 1));
+		__m512i product  = _mm512_mul_epu32(data_key, data_key_lo);
+		__m512i data_swap = _mm512_shuffle_epi32(data_vec, (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2));
+
+		a = _mm512_add_epi64(a, _mm512_add_epi64(product, data_swap));
+	}
+	_mm512_storeu_si512(acc, a);
+}
+
+__attribute__((target("avx512f")))
+static void xxh3_scramble_avx512(uint64_t *acc, const uint8_t *secret)
+{
+	const __m512i prime32 = _mm512_set1_epi32((int)PRIME32_1);
+	__m512i a = _mm512_loadu_si512(acc);
+	__m512i key_vec = _mm512_loadu_si512(secret);
+	__m512i data_key, prod_lo, prod_hi;
+
+	a = _mm512_xor_si512(a, _mm512_srli_epi64(a, 47));
+	data_key = _mm512_xor_si512(a, key_vec);
+	prod_lo = _mm512_mul_epu32(data_key, prime32);
+	prod_hi = _mm512_mul_epu32(_mm512_srli_epi64(data_key, 32), prime32);
+	a = _mm512_add_epi64(prod_lo, _mm512_slli_epi64(prod_hi, 32));
+	_mm512_storeu_si512(acc, a);
+}
+
+static const struct xxh3_kernel xxh3_kernel_avx512 = {
+	xxh3_accumulate_avx512, xxh3_scramble_avx512,
+};
+#endif /* XXH3_X86 */
+
+static const struct xxh3_kernel *xxh3_kernel_selected;
+
+static const struct xxh3_kernel *xxh3_kernel_select(void)
+{
+	switch (cpu_level()) {
+#ifdef XXH3_X86
+	case CPU_LEVEL_AVX512:
+		return &xxh3_kernel_avx512;
+	case CPU_LEVEL_AVX2:
+		return &xxh3_kernel_avx2;
+	case CPU_LEVEL_SSE42:
+	case CPU_LEVEL_SSE2:
+		return &xxh3_kernel_sse2;
+#endif
+	default:
+		return &xxh3_kernel_scalar;
+	}
+}
+
+__attribute__((constructor))
+static void xxh3_kernel_init(void)
+{
+	__atomic_store_n(&xxh3_kernel_selected, xxh3_kernel_select(),
+			 __ATOMIC_RELAXED);
+}
+
+/* Picked at load time; a caller from another constructor may come first. */
+static inline const struct xxh3_kernel *xxh3_kernel(void)
+{
+	const struct xxh3_kernel *k;
+
+	k = __atomic_load_n(&xxh3_kernel_selected, __ATOMIC_RELAXED);
+	if (unlikely(!k)) {
+		xxh3_kernel_init();
+		k = __atomic_load_n(&xxh3_kernel_selected, __ATOMIC_RELAXED);
+	}
+	return k;
+}
+
+static void xxh3_init_acc(uint64_t *acc)
+{
+	acc[0] = PRIME32_3;
+	acc[1] = PRIME64_1;
+	acc[2] = PRIME64_2;
+	acc[3] = PRIME64_3;
+	acc[4] = PRIME64_4;
+	acc[5] = PRIME32_2;
+	acc[6] = PRIME64_5;
+	acc[7] = PRIME32_1;
+}
+
+/* Derive the secret of a seed; a zero seed gives the default secret. */
+static void xxh3_init_secret(uint8_t *secret, uint64_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < XXH3_SECRET_SIZE; i += 16) {
+		xxh3_write64(secret + i, xxh3_read64(xxh3_secret + i) + seed);
+		xxh3_write64(secret + i + 8, xxh3_read64(xxh3_secret + i + 8) - seed);
+	}
+}
+
+static void xxh3_hash_long(uint64_t *acc, const uint8_t *p, size_t len,
+			   const uint8_t *secret)
+{
+	const struct xxh3_kernel *k = xxh3_kernel();
+	const size_t block_len = STRIPE_LEN * STRIPES_PER_BLOCK;
+	const size_t nb_blocks = (len - 1) / block_len;
+	size_t n, nb_stripes;
+
+	xxh3_init_acc(acc);
+	for (n = 0; n < nb_blocks; n++) {
+		k->accumulate(acc, p + n * block_len, secret, STRIPES_PER_BLOCK);
+		k->scramble(acc, secret + SECRET_LIMIT);
+	}
+
+	/* the last partial block, then the last stripe, which may overlap */
+	nb_stripes = ((len - 1) - block_len * nb_blocks) / STRIPE_LEN;
+	k->accumulate(acc, p + nb_blocks * block_len, secret, nb_stripes);
+	k->accumulate(acc, p + len - STRIPE_LEN,
+		      secret + SECRET_LIMIT - SECRET_LASTACC_START, 1);
+}
+
+static uint64_t xxh3_merge_accs(const uint64_t *acc, const uint8_t *secret,
+				uint64_t start)
+{
+	uint64_t result = start;
+	size_t i;
+
+	for (i = 0; i < 4; i++)
+		result += xxh3_mul128_fold64(
+			acc[2 * i] ^ xxh3_read64(secret + 16 * i),
+			acc[2 * i + 1] ^ xxh3_read64(secret + 16 * i + 8));
+	return xxh3_avalanche(result);
+}
+
+static uint64_t xxh3_long_digest_64(const uint64_t *acc, const uint8_t *secret,
+				    uint64_t len)
+{
+	return xxh3_merge_accs(acc, secret + SECRET_MERGEACCS_START,
+			       len * PRIME64_1);
+}
+
+static struct xxh128_hash xxh3_long_digest_128(const uint64_t *acc,
+					       const uint8_t *secret, uint64_t len)
+{
+	struct xxh128_hash h;
+
+	h.low64  = xxh3_merge_accs(acc, secret + SECRET_MERGEACCS_START,
+				   len * PRIME64_1);
+	h.high64 = xxh3_merge_accs(acc, secret + XXH3_SECRET_SIZE - STRIPE_LEN -
+				   SECRET_MERGEACCS_START, ~(len * PRIME64_2));
+	return h;
+}
+
+/*-***************************
+ * Simple Hash Functions
+ ****************************/
+uint64_t xxh3_64(const void *input, size_t len, uint64_t seed)
+{
+	const uint8_t *p = (const uint8_t *)input;
+	uint8_t secret[XXH3_SECRET_SIZE] __aligned(64);
+	uint64_t acc[ACC_NB] __aligned(64);
+
+	if (len <= 16)
+		return xxh3_len_0to16_64(p, len, xxh3_secret, seed);
+	if (len <= 128)
+		return xxh3_len_17to128_64(p, len, xxh3_secret, seed);
+	if (len <= MIDSIZE_MAX)
+		return xxh3_len_129to240_64(p, len, xxh3_secret, seed);
+
+	if (!seed) {
+		xxh3_hash_long(acc, p, len, xxh3_secret);
+		return xxh3_long_digest_64(acc, xxh3_secret, len);
+	}
+	xxh3_init_secret(secret, seed);
+	xxh3_hash_long(acc, p, len, secret);
+	return xxh3_long_digest_64(acc, secret, len);
+}
+
+struct xxh128_hash xxh3_128(const void *input, size_t len, uint64_t seed)
+{
+	const uint8_t *p = (const uint8_t *)input;
+	uint8_t secret[XXH3_SECRET_SIZE] __aligned(64);
+	uint64_t acc[ACC_NB] __aligned(64);
+
+	if (len <= 16)
+		return xxh3_len_0to16_128(p, len, xxh3_secret, seed);
+	if (len <= 128)
+		return xxh3_len_17to128_128(p, len, xxh3_secret, seed);
+	if (len <= MIDSIZE_MAX)
+		return xxh3_len_129to240_128(p, len, xxh3_secret, seed);
+
+	if (!seed) {
+		xxh3_hash_long(acc, p, len, xxh3_secret);
+		return xxh3_long_digest_128(acc, xxh3_secret, len);
+	}
+	xxh3_init_secret(secret, seed);
+	xxh3_hash_long(acc, p, len, secret);
+	return xxh3_long_digest_128(acc, secret, len);
+}
+
+/*-**************************************************
+ * Advanced Hash Functions
+ ***************************************************/
+void xxh3_copy_state(struct xxh3_state *dst, const struct xxh3_state *src)
+{
+	memcpy(dst, src, sizeof(*dst));
+}
+
+void xxh3_64_reset(struct xxh3_state *state, uint64_t seed)
+{
+	memset(state, 0, sizeof(*state));
+	xxh3_init_acc(state->acc);
+	xxh3_init_secret(state->custom_secret, seed);
+	state->seed = seed;
+}
+
+void xxh3_128_reset(struct xxh3_state *state, uint64_t seed)
+{
+	xxh3_64_reset(state, seed);
+}
+
+/*
+ * Feed nb_stripes stripes to the accumulators, scrambling them when a block
+ * of the secret is used up. A call never covers more than one block.
+ */
+static void xxh3_consume_stripes(const struct xxh3_kernel *k, uint64_t *acc,
+				 uint32_t *nb_stripes_so_far, const uint8_t *p,
+				 size_t nb_stripes, const uint8_t *secret)
+{
+	size_t to_end = STRIPES_PER_BLOCK - *nb_stripes_so_far;
+
+	if (to_end <= nb_stripes) {
+		k->accumulate(acc, p, secret + *nb_stripes_so_far *
+			      SECRET_CONSUME_RATE, to_end);
+		k->scramble(acc, secret + SECRET_LIMIT);
+		k->accumulate(acc, p + to_end * STRIPE_LEN, secret,
+			      nb_stripes - to_end);
+		*nb_stripes_so_far = nb_stripes - to_end;
+	} else {
+		k->accumulate(acc, p, secret + *nb_stripes_so_far *
+			      SECRET_CONSUME_RATE, nb_stripes);
+		*nb_stripes_so_far += nb_stripes;
+	}
+}
+
+int xxh3_64_update(struct xxh3_state *state, const void *input, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)input;
+	const uint8_t *const b_end = p + len;
+	const struct xxh3_kernel *k;
+
+	if (input == NULL)
+		return len ? -EINVAL : 0;
+
+	state->total_len += len;
+
+	if (len <= XXH3_BUFFER_SIZE - state->buffered_size) { /* fill in tmp buffer */
+		memcpy(state->buffer + state->buffered_size, input, len);
+		state->buffered_size += len;
+		return 0;
+	}
+
+	/*
+	 * Input is only consumed once more is known to follow, so that the
+	 * last stripe is always handled by the digest.
+	 */
+	k = xxh3_kernel();
+	if (state->buffered_size) {
+		size_t load = XXH3_BUFFER_SIZE - state->buffered_size;
+
+		memcpy(state->buffer + state->buffered_size, p, load);
+		p += load;
+		xxh3_consume_stripes(k, state->acc, &state->nb_stripes_so_far,
+				     state->buffer, BUFFER_STRIPES,
+				     state->custom_secret);
+		state->buffered_size = 0;
+	}
+
+	if ((size_t)(b_end - p) > XXH3_BUFFER_SIZE) {
+		const uint8_t *const limit = b_end - XXH3_BUFFER_SIZE;
+
+		do {
+			xxh3_consume_stripes(k, state->acc,
+					     &state->nb_stripes_so_far, p,
+					     BUFFER_STRIPES, state->custom_secret);
+			p += XXH3_BUFFER_SIZE;
+		} while (p < limit);
+		/* the digest may need the stripe before the buffered bytes */
+		memcpy(state->buffer + XXH3_BUFFER_SIZE - STRIPE_LEN,
+		       p - STRIPE_LEN, STRIPE_LEN);
+	}
+
+	memcpy(state->buffer, p, b_end - p);
+	state->buffered_size = b_end - p;
+	return 0;
+}
+
+int xxh3_128_update(struct xxh3_state *state, const void *input, size_t len)
+{
+	return xxh3_64_update(state, input, len);
+}
+
+/* Run the buffered input through a copy of the accumulators. */
+static void xxh3_digest_long(const struct xxh3_state *state, uint64_t *acc)
+{
+	const struct xxh3_kernel *k = xxh3_kernel();
+	const uint8_t *secret = state->custom_secret;
+	uint8_t last_stripe[STRIPE_LEN];
+	const uint8_t *last;
+
+	memcpy(acc, state->acc, sizeof(state->acc));
+	if (state->buffered_size >= STRIPE_LEN) {
+		size_t nb_stripes = (state->buffered_size - 1) / STRIPE_LEN;
+		uint32_t so_far = state->nb_stripes_so_far;
+
+		xxh3_consume_stripes(k, acc, &so_far, state->buffer, nb_stripes,
+				     secret);
+		last = state->buffer + state->buffered_size - STRIPE_LEN;
+	} else {
+		size_t catchup = STRIPE_LEN - state->buffered_size;
+
+		memcpy(last_stripe, state->buffer + XXH3_BUFFER_SIZE - catchup,
+		       catchup);
+		memcpy(last_stripe + catchup, state->buffer, state->buffered_size);
+		last = last_stripe;
+	}
+	k->accumulate(acc, last, secret + SECRET_LIMIT - SECRET_LASTACC_START, 1);
+}
+
+uint64_t xxh3_64_digest(const struct xxh3_state *state)
+{
+	uint64_t acc[ACC_NB] __aligned(64);
+
+	if (state->total_len > MIDSIZE_MAX) {
+		xxh3_digest_long(state, acc);
+		return xxh3_long_digest_64(acc, state->custom_secret,
+					   state->total_len);
+	}
+	return xxh3_64(state->buffer, state->total_len, state->seed);
+}
+
+struct xxh128_hash xxh3_128_digest(const struct xxh3_state *state)
+{
+	uint64_t acc[ACC_NB] __aligned(64);
+
+	if (state->total_len > MIDSIZE_MAX) {
+		xxh3_digest_long(state, acc);
+		return xxh3_long_digest_128(acc, state->custom_secret,
+					    state->total_len);
+	}
+	return xxh3_128(state->buffer, state->total_len, state->seed);
+}
@@ -49,6 +49,29 @@
 #define xxh_rotl32(x, r) ((x << r) | (x >> (32 - r)))
 #define xxh_rotl64(x, r) ((x << r) | (x >> (64 - r)))
 
+/* unaligned.h only covers C6x, read little-endian words through memcpy */
+static inline uint32_t get_unaligned_le32(const void *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline uint64_t get_unaligned_le64(const void *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
 /*-*************************************
  * Constants
  **************************************/
@@ -223,6 +246,138 @@ uint64_t xxh64(const void *input, const size_t len, const uint64_t seed)
 	return h64;
 }
 
+/*-**************************************************
+ * Batch Hash Functions
+ ***************************************************/
+
+/*
+ * Keys shorter than 32 bytes are hashed XXH_BATCH_LANES at a time in
+ * lockstep. Each step below runs on every lane before the next one, so the
+ * multiply chains of independent keys overlap instead of each key waiting
+ * for the latency of its own chain. 64-bit lane multiplies have no SSE2 or
+ * AVX2 instruction, so the lanes are interleaved scalars, not vectors.
+ */
+#define XXH_BATCH_LANES 4
+
+/*
+ * Hash XXH_BATCH_LANES short keys of the same length, every step of the
+ * algorithm run on all lanes before the next one.
+ */
+static __always_inline void xxh64_lanes(const uint8_t *const *p, size_t len,
+					uint64_t seed, uint64_t *out)
+{
+	uint64_t h[XXH_BATCH_LANES];
+	size_t off = 0;
+	int l;
+
+	for (l = 0; l < XXH_BATCH_LANES; l++)
+		h[l] = seed + PRIME64_5 + len;
+
+	for (; off + 8 <= len; off += 8)
+		for (l = 0; l < XXH_BATCH_LANES; l++)
+			h[l] = xxh_rotl64((h[l] ^ xxh64_round(0,
+				get_unaligned_le64(p[l] + off))), 27) *
+				PRIME64_1 + PRIME64_4;
+
+	if (off + 4 <= len) {
+		for (l = 0; l < XXH_BATCH_LANES; l++)
+			h[l] = xxh_rotl64((h[l] ^ (uint64_t)get_unaligned_le32(p[l] + off) *
+				PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+		off += 4;
+	}
+
+	for (; off < len; off++)
+		for (l = 0; l < XXH_BATCH_LANES; l++)
+			h[l] = xxh_rotl64((h[l] ^ p[l][off] * PRIME64_5), 11) *
+				PRIME64_1;
+
+	for (l = 0; l < XXH_BATCH_LANES; l++) {
+		uint64_t h64 = h[l];
+
+		h64 ^= h64 >> 33;
+		h64 *= PRIME64_2;
+		h64 ^= h64 >> 29;
+		h64 *= PRIME64_3;
+		h64 ^= h64 >> 32;
+		out[l] = h64;
+	}
+}
+
+void xxh64_batch(const void *const *keys, const size_t *lens, size_t n,
+		 uint64_t seed, uint64_t *out)
+{
+	/* short keys wait in a group of their length until it is full */
+	const uint8_t *p[32][XXH_BATCH_LANES];
+	size_t idx[32][XXH_BATCH_LANES];
+	uint8_t nb[32] = { 0 };
+	uint64_t h[XXH_BATCH_LANES];
+	size_t i, len;
+	int l;
+
+	for (i = 0; i < n; i++) {
+		len = lens[i];
+		if (len >= 32) {
+			out[i] = xxh64(keys[i], len, seed);
+			continue;
+		}
+		p[len][nb[len]]   = keys[i];
+		idx[len][nb[len]] = i;
+		if (++nb[len] < XXH_BATCH_LANES)
+			continue;
+		xxh64_lanes(p[len], len, seed, h);
+		for (l = 0; l < XXH_BATCH_LANES; l++)
+			out[idx[len][l]] = h[l];
+		nb[len] = 0;
+	}
+	for (len = 0; len < 32; len++)
+		for (l = 0; l < nb[len]; l++)
+			out[idx[len][l]] = xxh64(p[len][l], len, seed);
+}
+
+/* Hash the keys in whole groups, return how many were hashed. */
+static __always_inline size_t xxh64_batch_fixed_lanes(const uint8_t *base,
+						      size_t key_size, size_t n,
+						      uint64_t seed, uint64_t *out)
+{
+	size_t i;
+	int l;
+
+	for (i = 0; i + XXH_BATCH_LANES <= n; i += XXH_BATCH_LANES) {
+		const uint8_t *p[XXH_BATCH_LANES];
+
+		for (l = 0; l < XXH_BATCH_LANES; l++)
+			p[l] = base + (i + l) * key_size;
+		xxh64_lanes(p, key_size, seed, out + i);
+	}
+	return i;
+}
+
+void xxh64_batch_fixed(const void *keys, size_t key_size, size_t n,
+		       uint64_t seed, uint64_t *out)
+{
+	const uint8_t *base = (const uint8_t *)keys;
+	size_t i = 0;
+
+	switch (key_size) {
+	/* constant sizes let the compiler unroll the common key types */
+	case 4:
+		i = xxh64_batch_fixed_lanes(base, 4, n, seed, out);
+		break;
+	case 8:
+		i = xxh64_batch_fixed_lanes(base, 8, n, seed, out);
+		break;
+	case 16:
+		i = xxh64_batch_fixed_lanes(base, 16, n, seed, out);
+		break;
+	default:
+		if (key_size < 32)
+			i = xxh64_batch_fixed_lanes(base, key_size, n, seed, out);
+		break;
+	}
+	for (; i < n; i++)
+		out[i] = xxh64(base + i * key_size, key_size, seed);
+}
+
 /*-**************************************************
  * Advanced Hash Functions
  ***************************************************/
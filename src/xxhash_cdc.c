@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Content-defined chunking with xxh64 digests
+ */
+#include <errno.h>
+#include <limits.h>
+#include <xxhash.h>
+#include <xxhash_cdc.h>
+#include <compiler.h>
+
+/*
+ * Random gear values, splitmix64 from 0x6765617274616231. They are part of
+ * the chunk format: changing them moves every boundary.
+ */
+static const uint64_t xxh_cdc_gear[256] = {
+	0x57426723552238f4ULL, 0xb945114e85e66514ULL, 0xa40a3fbd2a5eec19ULL,
+	0x78c0e220c00fd721ULL, 0xab760dcc99b872c9ULL, 0xa7d643524a838c1eULL,
+	0x5d38930cc604aa7dULL, 0x235d00bec8cfa642ULL, 0x45e5bbd0179acfd9ULL,
+	0xe77a7a384da6a968ULL, 0xe927f05664821b1fULL, 0x601a9f4f03b181caULL,
+	0x9bb31fa3edceb457ULL, 0xe62489909d56e0a3ULL, 0x59dcca6fa6ad487dULL,
+	0x7f786343c2ef5a07ULL, 0x5cbb1bcfc6736ce6ULL, 0x356333e551a87c40ULL,
+	0xad879385b0dccc97ULL, 0xf48acae5e8b43d49ULL, 0x873aad365dc141beULL,
+	0xaa3dff4730b7411eULL, 0xb56f4d36b01bc3bfULL, 0x439bd8e3a020fe20ULL,
+	0xc595aa4848c5b53bULL, 0xd082aac4790fef44ULL, 0xa657ba333cc7db43ULL,
+	0xdff096787045100eULL, 0x9fa5a960c91a3c58ULL, 0x0fb5ebe221d19d77ULL,
+	0xf8f4361a2f7ad5e8ULL, 0xa7e6736559be5a6eULL, 0x66ccbe76d7af974fULL,
+	0x352035213b8c53f2ULL, 0x40c21debcb36258dULL, 0x6b66461ad2d44023ULL,
+	0xed39faa3199af918ULL, 0xf65b6f3671803129ULL, 0x4c9c239ad2fcfcffULL,
+	0x8e2da9760cadc584ULL, 0x009144077b5add5dULL, 0x6b4b469f2b34cd59ULL,
+	0xdd4c82780b3f9d82ULL, 0x2e98054596b96b71ULL, 0x64f2286d3fdbea68ULL,
+	0x0f9616e58150faf1ULL, 0xf42957aecf7a70e7ULL, 0x44b5bf777e047811ULL,
+	0x875e6a91cf0ee98fULL, 0xc8dc44e57cc8087aULL, 0xfec946ebf213947dULL,
+	0x0e30f972e427c964ULL, 0x5f272aa6cd0252a5ULL, 0x7deadc95269931e0ULL,
+	0x1ad98cd2d2ae31b5ULL, 0xb03b630c9c26a9a3ULL, 0x2bc5d07c96cd8effULL,
+	0xc7e732cc146a387dULL, 0x0f293277d24dbe13ULL, 0x43997101d89adc4eULL,
+	0x4992a012e5c0a14fULL, 0x8d65801d5c6ed2fcULL, 0x95ee70b5dd53b335ULL,
+	0x9b37af915d9955edULL, 0x188b0fec1d133d63ULL, 0xf2f0e397eb37f12bULL,
+	0x876f63d82acad887ULL, 0xc3915c4ea92f574cULL, 0xe09d02c39a28a526ULL,
+	0x03bf234cbcb19434ULL, 0x668b58dbef7ea011ULL, 0x7bf0da92e657ebbdULL,
+	0x9359332c1abb1028ULL, 0x56eb75d5a5467bcaULL, 0xd949d1bb2aeacaa3ULL,
+	0x86b3b31b7cbee931ULL, 0x9e48a5d03d16e97bULL, 0x43af2db041bdb921ULL,
+	0x7ebf9976a8404f4dULL, 0xc4505c9e31256234ULL, 0xf344831c58279592ULL,
+	0x03efc049ec78990fULL, 0xec3571e8ad0ce935ULL, 0x88901f2fcc744cd6ULL,
+	0xa829877978a43dfeULL, 0xc85089d313fe4c84ULL, 0x2396ed1a7f08f693ULL,
+	0x5798c97e4ee103acULL, 0x85dff2aa51dc71a1ULL, 0x15ed3230534a7692ULL,
+	0x715fccf5daaa3d58ULL, 0x46867d72437b2db9ULL, 0x047080ac6e30f887ULL,
+	0x81665929da9ceb3bULL, 0x16873cbe2ee9a7b4ULL, 0xa79109ef02f67dadULL,
+	0x46ed0deee090ad98ULL, 0xf08e80c803670df4ULL, 0xb636828c1494b43aULL,
+	0x6e7c5306c1654674ULL, 0x185f3d94544c1b75ULL, 0xde4b7a714943948fULL,
+	0x1848c4998e6b9116ULL, 0xbf9cebc681efb1e9ULL, 0x49bb258261d46507ULL,
+	0x3762d541c62b1815ULL, 0xa133e37bb37a2f2bULL, 0xc5d859b4f20b37e1ULL,
+	0xc096a4848dd921b5ULL, 0x60964a1726c54768ULL, 0x9400c3324f6b0c59ULL,
+	0xdb427202859a602dULL, 0xcfdf1a0bdef63706ULL, 0x5560317a3c0f2266ULL,
+	0xb075863d3548ee4cULL, 0x03aeebda68c02956ULL, 0xaf267c67a9de17eeULL,
+	0x014ad11dc534b9f3ULL, 0xe6bc1ca7380b9cb8ULL, 0xad9ed6d10cf9ffb5ULL,
+	0x14fad7aeec7f0982ULL, 0xc06b3df1225c3687ULL, 0x45ba5a2f25329306ULL,
+	0x18be0ed47a12e7c2ULL, 0x9232ddc62f35330cULL, 0xb09b6898b26fc41fULL,
+	0xdaf140239ce9b7b7ULL, 0xe6468e47cd1e7954ULL, 0x746c788faa557e64ULL,
+	0x030eacb9f0b62dfbULL, 0x71c8937d06ea6810ULL, 0x036eae4f95b5a106ULL,
+	0xf7a769e7990974d5ULL, 0x017b52161aac9739ULL, 0xb62696bd4b633cf7ULL,
+	0x6203a11c45c96482ULL, 0x45d92425a654cd75ULL, 0x6f34c25cf888368bULL,
+	0x61d15a9a3b6a3278ULL, 0xd3401d06797c0dafULL, 0x18d59250b5538f20ULL,
+	0xf512955fa85f6afcULL, 0x97a283e8cfed9ab2ULL, 0x6b8c4d6b770655a6ULL,
+	0x9ca977f5537d6ea5ULL, 0xb3f47bd3ea2f2702ULL, 0x2eb7da05a7ab887aULL,
+	0xf008057f314dc46aULL, 0x7742a66358308bceULL, 0x90c229fbf094c1b2ULL,
+	0x7099490787394b33ULL, 0x831e4d371e41cbfcULL, 0x4eac2f1ce6579ea9ULL,
+	0x2f012d86d8d4b321ULL, 0xf219540ab77cfb15ULL, 0xc853d63bbeec3c0eULL,
+	0x44076c103b3a0340ULL, 0x59dee5585e4bc4d7ULL, 0xee0c088b060415eeULL,
+	0x75cdb62da094e39dULL, 0x372e853adc396605ULL, 0x7cb4152d961cc1afULL,
+	0xa1719d606accfba3ULL, 0xcde38a312d9e6fdbULL, 0x977db338fe1b2de5ULL,
+	0xa90666527717b0b9ULL, 0x0efc7ce3a976e991ULL, 0x490383207e907821ULL,
+	0xd5d4e130611cb93aULL, 0xc6bb7f552d040b0eULL, 0xf461ee9340ace2a9ULL,
+	0x2318830f7452032bULL, 0x6c1232021235687dULL, 0x0858d1250cd12f39ULL,
+	0xf4933431519a935aULL, 0xc9b753386d3cb33dULL, 0xe7dd0bc67ec94096ULL,
+	0x4a976e1ab9cfb4dbULL, 0x7a71ea34530a7d6cULL, 0x1e84b6b3e9b8d4feULL,
+	0x574621a376f9c473ULL, 0x3dab457f29d38437ULL, 0x7545e8d1f68c2629ULL,
+	0x428cb93f60de37ffULL, 0x439547f7c663216aULL, 0x0321bde338321b49ULL,
+	0xe5efa778181bc51dULL, 0x04bbf1c0c2040cfcULL, 0x3058a2ae782678b8ULL,
+	0x312894cd635d3c10ULL, 0x368dd35dfd8fbda8ULL, 0x90c73fd7f4ac529bULL,
+	0x8652a2ca739b04b9ULL, 0x28843feb75ca3218ULL, 0xd27eeaef0374da2dULL,
+	0xc1edce825d552a8aULL, 0xed5d944ddb8a445eULL, 0x5890d684037d65b7ULL,
+	0xc036d21a0c1ac256ULL, 0xfe5322aeb6c0f88eULL, 0x706341f0c347f559ULL,
+	0x1285987c4f771c5eULL, 0x4d6879bebf54558fULL, 0xdc120cbc6f5631d4ULL,
+	0xfaa953dbbe1ed64dULL, 0x3506f8e369cd74b0ULL, 0x0993196d7d5fd587ULL,
+	0x48510b93f21f27f0ULL, 0xdc460fbff275026cULL, 0x3956c86427468a14ULL,
+	0xd08186be794c6fa8ULL, 0x388194407f9e2b71ULL, 0xf80a471853d27029ULL,
+	0xa7887c53c4cf714eULL, 0x938cce6a5523a37dULL, 0xf69be8628003f73eULL,
+	0x8e319a094532e2afULL, 0x8c1fae22200b42aaULL, 0xb733deff72dc8a60ULL,
+	0x56a4104388beee90ULL, 0xfde1940ed5ce97b1ULL, 0x4c7f4dc0a17f7208ULL,
+	0x59fe6422da9326b8ULL, 0x370acfb48a9b811bULL, 0x50e89082e7d416f5ULL,
+	0x404403369b28d422ULL, 0x87364b34085c91b1ULL, 0x33057aff774cb86dULL,
+	0x023e2e002347adcdULL, 0x899bab4bebf58bf0ULL, 0x0563c08f8de3becaULL,
+	0x42455856eb9f69c0ULL, 0x63c749005260b102ULL, 0xf85e1453060a2612ULL,
+	0xee58070632e0b488ULL, 0x879ddf90c89c41fdULL, 0x8a92ccfcb67b158cULL,
+	0x34ec5809a71b5938ULL, 0x22c7241ea67ebabfULL, 0x4ba3b6bd676e0373ULL,
+	0xa7e4f00e9328cbf6ULL, 0x9b6529dde6eacea6ULL, 0xd628b4e645ea6d7bULL,
+	0xb29fd13540b63271ULL, 0x7950d6101876834dULL, 0xcd2bd23ff3cfcfcaULL,
+	0x7a81503ab47d1f48ULL, 0x5797b87b32d1d7c5ULL, 0x0fe3d6eb8360c7a9ULL,
+	0x22dca8df9432335dULL, 0x6b52d516e52eedc3ULL, 0x4d9f30f3a39719c1ULL,
+	0xbec401ba844f43abULL, 0x574f9bd7b7162d89ULL, 0x33713cfe01d91db1ULL,
+	0x706709c4eeb590c5ULL,
+};
+
+static inline uint64_t xxh_cdc_mask(unsigned int bits)
+{
+	return ~0ULL << (64 - bits);
+}
+
+int xxh_cdc_init(struct xxh_cdc *cdc, size_t min_size, size_t avg_size,
+		 size_t max_size, int level, uint64_t seed)
+{
+	unsigned int bits;
+
+	if (!min_size || min_size > avg_size || avg_size > max_size ||
+	    level < 0 || level > 3)
+		return -EINVAL;
+	bits = 63 - __builtin_clzll(avg_size);
+	if (bits <= (unsigned int)level || bits + level > 63)
+		return -EINVAL;
+
+	cdc->min_size = min_size;
+	cdc->avg_size = avg_size;
+	cdc->max_size = max_size;
+	cdc->mask_s = xxh_cdc_mask(bits + level);
+	cdc->mask_l = xxh_cdc_mask(bits - level);
+	cdc->seed = seed;
+	cdc->gear = 0;
+	cdc->length = 0;
+	cdc->offset = 0;
+	xxh64_reset(&cdc->state, seed);
+	return 0;
+}
+
+static void xxh_cdc_emit(struct xxh_cdc *cdc, struct xxh_cdc_chunk *chunk)
+{
+	chunk->offset = cdc->offset;
+	chunk->length = cdc->length;
+	chunk->digest = xxh64_digest(&cdc->state);
+
+	cdc->offset += cdc->length;
+	cdc->length = 0;
+	cdc->gear = 0;
+	xxh64_reset(&cdc->state, cdc->seed);
+}
+
+int xxh_cdc_update(struct xxh_cdc *cdc, const void *input, size_t length,
+		   size_t *consumed, struct xxh_cdc_chunk *chunk)
+{
+	const uint8_t *p = input;
+	size_t base = cdc->length;
+	uint64_t h = cdc->gear;
+	size_t i = 0, limit;
+	int cut = 0;
+
+	/* i counts the bytes of input, base + i is the position in the chunk */
+	if (base < cdc->min_size)
+		i = min(length, cdc->min_size - base);
+
+	limit = base < cdc->avg_size ? min(length, cdc->avg_size - base) : 0;
+	for (; i < limit; i++) {
+		h = (h << 1) + xxh_cdc_gear[p[i]];
+		if (!(h & cdc->mask_s)) {
+			cut = 1;
+			i++;
+			goto out;
+		}
+	}
+
+	limit = min(length, cdc->max_size - base);
+	for (; i < limit; i++) {
+		h = (h << 1) + xxh_cdc_gear[p[i]];
+		if (!(h & cdc->mask_l)) {
+			cut = 1;
+			i++;
+			goto out;
+		}
+	}
+	cut = base + i == cdc->max_size;
+
+out:
+	xxh64_update(&cdc->state, p, i);
+	cdc->length += i;
+	cdc->gear = h;
+	*consumed = i;
+	if (cut)
+		xxh_cdc_emit(cdc, chunk);
+	return cut;
+}
+
+int xxh_cdc_fifo(struct xxh_cdc *cdc, fifo_buffer *f,
+		 struct xxh_cdc_chunk *chunk)
+{
+	uint8_t *ptr[2];
+	int len[2], s;
+	size_t used;
+
+	while (fifo_read_acquire(f, INT_MAX, ptr, len)) {
+		for (s = 0; s < 2 && len[s]; s++) {
+			int cut = xxh_cdc_update(cdc, ptr[s], len[s], &used,
+						 chunk);
+
+			fifo_read_release(f, used);
+			if (cut)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+int xxh_cdc_finish(struct xxh_cdc *cdc, struct xxh_cdc_chunk *chunk)
+{
+	int ret = 0;
+
+	if (cdc->length) {
+		xxh_cdc_emit(cdc, chunk);
+		ret = 1;
+	}
+	cdc->offset = 0;
+	return ret;
+}
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Incremental Merkle tree over xxh64
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xxhash.h>
+#include <xxhash_merkle.h>
+#include <compiler.h>
+
+static inline uint64_t xxh_merkle_le64(uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return __builtin_bswap64(v);
+#else
+	return v;
+#endif
+}
+
+/* Rehash node i from its block or from its two children. */
+static void xxh_merkle_hash(struct xxh_merkle *tree, size_t i)
+{
+	uint64_t child[2];
+	size_t off;
+
+	if (i >= tree->nb_slots) {
+		off = (i - tree->nb_slots) * tree->block_size;
+		tree->node[i] = xxh64(tree->data + off,
+				      min(tree->block_size, tree->length - off),
+				      tree->seed);
+		return;
+	}
+	child[0] = xxh_merkle_le64(tree->node[2 * i]);
+	child[1] = xxh_merkle_le64(tree->node[2 * i + 1]);
+	tree->node[i] = xxh64(child, sizeof(child), tree->seed + 1);
+}
+
+struct xxh_merkle *xxh_merkle_alloc(const void *data, size_t length,
+				    size_t block_size, uint64_t seed)
+{
+	struct xxh_merkle *tree;
+	size_t i;
+
+	if (!block_size)
+		return NULL;
+	tree = calloc(1, sizeof(*tree));
+	if (!tree)
+		return NULL;
+	tree->data = data;
+	tree->length = length;
+	tree->block_size = block_size;
+	tree->seed = seed;
+	tree->nb_leaves = length / block_size + !!(length % block_size);
+	tree->nb_slots = 1;
+	while (tree->nb_slots < tree->nb_leaves)
+		tree->nb_slots <<= 1;
+
+	/* padding leaves stay zero */
+	tree->node = calloc(2 * tree->nb_slots, sizeof(*tree->node));
+	tree->dirty = calloc(2 * tree->nb_slots, sizeof(*tree->dirty));
+	tree->queue = malloc(tree->nb_slots * sizeof(*tree->queue));
+	if (!tree->node || !tree->dirty || !tree->queue) {
+		xxh_merkle_free(tree);
+		return NULL;
+	}
+
+	for (i = 0; i < tree->nb_leaves; i++)
+		xxh_merkle_hash(tree, tree->nb_slots + i);
+	for (i = tree->nb_slots - 1; i >= 1; i--)
+		xxh_merkle_hash(tree, i);
+	return tree;
+}
+
+void xxh_merkle_free(struct xxh_merkle *tree)
+{
+	if (!tree)
+		return;
+	free(tree->node);
+	free(tree->dirty);
+	free(tree->queue);
+	free(tree);
+}
+
+int xxh_merkle_mark_dirty(struct xxh_merkle *tree, size_t offset,
+			  size_t length)
+{
+	size_t first, last, i;
+
+	if (offset > tree->length || length > tree->length - offset)
+		return -EINVAL;
+	if (!length)
+		return 0;
+	first = offset / tree->block_size;
+	last = (offset + length - 1) / tree->block_size;
+	for (i = tree->nb_slots + first; i <= tree->nb_slots + last; i++) {
+		if (tree->dirty[i])
+			continue;
+		tree->dirty[i] = 1;
+		tree->queue[tree->nb_queued++] = i;
+	}
+	return 0;
+}
+
+/*
+ * The queue holds the dirty nodes of one level, all leaves to begin with.
+ * Once they are rehashed it is replaced by their parents, each queued once
+ * however many of its children were dirty, until the top is rehashed. A
+ * level never has more dirty nodes than the one below, so the parents are
+ * written over the front of the queue.
+ */
+size_t xxh_merkle_recompute(struct xxh_merkle *tree)
+{
+	size_t rehashed = tree->nb_queued;
+	size_t k, n, node, parent;
+
+	while (tree->nb_queued) {
+		for (k = 0; k < tree->nb_queued; k++) {
+			node = tree->queue[k];
+			xxh_merkle_hash(tree, node);
+			tree->dirty[node] = 0;
+		}
+		for (k = n = 0; k < tree->nb_queued; k++) {
+			parent = tree->queue[k] / 2;
+			if (!parent || tree->dirty[parent])
+				continue;
+			tree->dirty[parent] = 1;
+			tree->queue[n++] = parent;
+		}
+		tree->nb_queued = n;
+	}
+	return rehashed;
+}
+
+uint64_t xxh_merkle_root(const struct xxh_merkle *tree)
+{
+	uint64_t top[3];
+
+	top[0] = xxh_merkle_le64(tree->node[1]);
+	top[1] = xxh_merkle_le64(tree->length);
+	top[2] = xxh_merkle_le64(tree->block_size);
+	return xxh64(top, sizeof(top), tree->seed);
+}
+
+struct xxh_merkle_walk {
+	const struct xxh_merkle *a, *b;
+	int (*fn)(size_t offset, size_t length, void *opaque);
+	void *opaque;
+	size_t start, end;	/* run of changed blocks not reported yet */
+};
+
+static int xxh_merkle_flush(struct xxh_merkle_walk *w)
+{
+	size_t bs = w->a->block_size;
+	size_t off = w->start * bs;
+
+	if (w->start == w->end)
+		return 0;
+	return w->fn(off, min(w->end * bs, w->a->length) - off, w->opaque);
+}
+
+/* Visit the subtree of node i, left to right, if its digests differ. */
+static int xxh_merkle_walk(struct xxh_merkle_walk *w, size_t i)
+{
+	size_t block;
+	int ret;
+
+	if (w->a->node[i] == w->b->node[i])
+		return 0;
+	if (i < w->a->nb_slots) {
+		ret = xxh_merkle_walk(w, 2 * i);
+		return ret ? ret : xxh_merkle_walk(w, 2 * i + 1);
+	}
+
+	block = i - w->a->nb_slots;
+	if (block != w->end) {
+		ret = xxh_merkle_flush(w);
+		if (ret)
+			return ret;
+		w->start = block;
+	}
+	w->end = block + 1;
+	return 0;
+}
+
+int xxh_merkle_diff(const struct xxh_merkle *a, const struct xxh_merkle *b,
+		    int (*fn)(size_t offset, size_t length, void *opaque),
+		    void *opaque)
+{
+	struct xxh_merkle_walk w = {
+		.a = a, .b = b, .fn = fn, .opaque = opaque,
+	};
+	int ret;
+
+	if (a->length != b->length || a->block_size != b->block_size ||
+	    a->seed != b->seed)
+		return -EINVAL;
+	ret = xxh_merkle_walk(&w, 1);
+	return ret ? ret : xxh_merkle_flush(&w);
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Parallel tree hashing with xxh64
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <xxhash.h>
+#include <xxhash_tree.h>
+#include <compiler.h>
+
+struct xxh_tree_job {
+	const uint8_t *input;
+	size_t length;
+	size_t leaf_size;
+	size_t nb_leaves;
+	uint64_t seed;
+	uint64_t *digest;	/* one per leaf, in leaf order */
+	size_t next;		/* next leaf to claim, atomic */
+};
+
+static inline uint64_t xxh_tree_le64(uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return __builtin_bswap64(v);
+#else
+	return v;
+#endif
+}
+
+static inline uint64_t xxh_tree_leaf(const struct xxh_tree_job *job, size_t i)
+{
+	size_t off = i * job->leaf_size;
+
+	return xxh64(job->input + off, min(job->leaf_size, job->length - off),
+		     job->seed);
+}
+
+/*
+ * Leaves are claimed one at a time from a shared counter rather than split
+ * into a range per thread up front, so a thread stalled on page faults or
+ * descheduled does not hold back the leaves it would have owned.
+ */
+static void *xxh_tree_worker(void *arg)
+{
+	struct xxh_tree_job *job = arg;
+	size_t i;
+
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+	       job->nb_leaves)
+		job->digest[i] = xxh_tree_le64(xxh_tree_leaf(job, i));
+	return NULL;
+}
+
+static int xxh_tree_nb_threads(int nb_threads, size_t nb_leaves)
+{
+	long cpus;
+
+	if (nb_threads <= 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nb_threads = cpus > 0 ? cpus : 1;
+	}
+	return min((size_t)nb_threads, nb_leaves);
+}
+
+/*
+ * Hash every leaf with nb_threads - 1 workers and the calling thread, or
+ * the calling thread alone if they cannot be started.
+ */
+static void xxh_tree_run(struct xxh_tree_job *job, int nb_threads)
+{
+	pthread_t *tid;
+	int i, started = 0;
+
+	/* nb_threads is only capped by the leaf count, keep it off the stack */
+	tid = nb_threads > 1 ? malloc((nb_threads - 1) * sizeof(*tid)) : NULL;
+	for (i = 1; tid && i < nb_threads; i++) {
+		if (pthread_create(&tid[started], NULL, xxh_tree_worker, job))
+			break;
+		started++;
+	}
+	xxh_tree_worker(job);
+	for (i = 0; i < started; i++)
+		pthread_join(tid[i], NULL);
+	free(tid);
+}
+
+uint64_t xxh64_tree(const void *input, size_t length, size_t leaf_size,
+		    uint64_t seed, int nb_threads)
+{
+	struct xxh_tree_job job = {
+		.input = input,
+		.length = length,
+		.leaf_size = leaf_size ? leaf_size : XXH_TREE_LEAF_SIZE,
+		.seed = seed,
+	};
+	struct xxh64_state root;
+	uint64_t tail[2], digest;
+	size_t i;
+
+	job.nb_leaves = (length + job.leaf_size - 1) / job.leaf_size;
+	nb_threads = xxh_tree_nb_threads(nb_threads, job.nb_leaves);
+	xxh64_reset(&root, seed);
+
+	if (nb_threads > 1)
+		job.digest = malloc(job.nb_leaves * sizeof(*job.digest));
+	if (job.digest) {
+		xxh_tree_run(&job, nb_threads);
+		xxh64_update(&root, job.digest,
+			     job.nb_leaves * sizeof(*job.digest));
+		free(job.digest);
+	} else {
+		for (i = 0; i < job.nb_leaves; i++) {
+			digest = xxh_tree_le64(xxh_tree_leaf(&job, i));
+			xxh64_update(&root, &digest, sizeof(digest));
+		}
+	}
+
+	tail[0] = xxh_tree_le64(length);
+	tail[1] = xxh_tree_le64(job.leaf_size);
+	xxh64_update(&root, tail, sizeof(tail));
+	return xxh64_digest(&root);
+}
+
+int xxh64_tree_fd(int fd, size_t leaf_size, uint64_t seed, int nb_threads,
+		  uint64_t *hash)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	/* pipes, sockets and devices report a size of 0 too */
+	if (!S_ISREG(st.st_mode))
+		return -EINVAL;
+	if (!st.st_size) {
+		*hash = xxh64_tree(NULL, 0, leaf_size, seed, nb_threads);
+		return 0;
+	}
+	if ((uint64_t)st.st_size > SIZE_MAX)
+		return -EFBIG;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+	/* each worker reads its leaves front to back, ask for deep readahead */
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	*hash = xxh64_tree(map, st.st_size, leaf_size, seed, nb_threads);
+	munmap(map, st.st_size);
+	return 0;
+}